@@ -0,0 +1,343 @@
+// AI PLAYER //
+// Picks a placement for the current piece with a weighted board evaluator
+// (aggregate height, holes, bumpiness, lines cleared) and a beam-limited
+// lookahead. Every placement of the current piece is scored, and the best
+// `beamWidth` are kept. Each survivor is then scored by the average, over all
+// seven possible next pieces, of that piece's best follow-up placement. With
+// lookaheadDepth > 1 this repeats, expanding only the best `beamWidth`
+// follow-ups at each level. Survivors are spread across a WorkStealingPool if
+// one is given. Lookahead stops when the per-move time budget runs out, and
+// the move falls back to the greedy ranking. Node values can be cached in a
+// shared TranspositionTable, because different move orders often reach the
+// same board.
+
+#ifndef TETRIS_AI_H
+#define TETRIS_AI_H
+
+#include "algorithm"
+#include "chrono"
+#include "cstdlib"
+#include "vector"
+#include "eval_features.h"
+#include "movegen.h"
+#include "thread_pool.h"
+#include "transposition.h"
+
+// Struct for the evaluator weights
+struct EvalWeights
+{
+    double height; // Per row of aggregate column height
+    double lines; // Per line cleared
+    double holes; // Per empty cell with a filled cell above it
+    double bumpiness; // Per row of height difference between neighbouring columns
+
+    EvalWeights() : height(-0.510066), lines(0.760666), holes(-0.35663), bumpiness(-0.184483) {}
+};
+
+// Struct for the raw features the evaluator weighs
+struct BoardFeatures
+{
+    int aggregateHeight;
+    int holes;
+    int bumpiness;
+};
+
+// Function to measure a board's features with one pass over its rows
+inline BoardFeatures board_features(const Board& board)
+{
+    BoardFeatures f = {0, 0, 0};
+    int heights[GRID_WIDTH] = {0};
+    uint32_t covered = 0; // Columns that have a filled cell at or above the current row
+
+    for (int y = 0; y < GRID_HEIGHT; y++)
+    {
+        uint32_t row = board.rows[y];
+
+        // Columns whose top cell is in this row get their height here
+        uint32_t tops = row & ~covered;
+        for (int x = 0; tops; x++, tops >>= 1)
+        {
+            if (tops & 1)
+            {
+                heights[x] = GRID_HEIGHT - y;
+            }
+        }
+
+        f.holes += row_popcount(covered & ~row);
+        covered |= row;
+        f.aggregateHeight += row_popcount(covered);
+    }
+
+    for (int x = 0; x + 1 < GRID_WIDTH; x++)
+    {
+        f.bumpiness += std::abs(heights[x] - heights[x + 1]);
+    }
+    return f;
+}
+
+// Function to score a board after `lines` lines were cleared getting there (higher is better)
+inline double evaluate_board(const Board& board, int lines, const EvalWeights& w)
+{
+    BoardFeatures f = board_features(board);
+    return w.height * f.aggregateHeight + w.lines * lines + w.holes * f.holes + w.bumpiness * f.bumpiness;
+}
+
+// Function to score one lane of a feature batch the same way as evaluate_board
+inline double evaluate_features(const FeatureBatch& f, int lane, int lines, const EvalWeights& w)
+{
+    return w.height * f.aggregateHeight[lane] + w.lines * lines + w.holes * f.holes[lane] + w.bumpiness * f.bumpiness[lane];
+}
+
+const int AI_MAX_DEPTH = 4; // Deepest lookahead supported
+
+// Struct for one placement being considered inside the lookahead
+struct AiChild
+{
+    int index; // Index into that level's placement list
+    int lines; // Lines the placement cleared
+    double score; // Static score of the board it leaves
+};
+
+// Struct for one thread's search buffers
+struct AiWorker
+{
+    MoveGenerator gen;
+    PlacementList lists[AI_MAX_DEPTH + 1]; // One per lookahead level
+    AiChild children[AI_MAX_DEPTH + 1][MOVEGEN_STATES];
+    BoardBatch batch; // Placements waiting to be scored together
+    FeatureBatch features;
+    long long probes; // Transposition table lookups
+    long long hits; // Lookups that found a value
+
+    AiWorker() : probes(0), hits(0) {}
+};
+
+// Struct for one root candidate during a search
+struct AiCandidate
+{
+    int index; // Index into the root placement list
+    Board board; // Board after placing it and clearing lines
+    int lines; // Lines it cleared
+    double score; // Greedy score, replaced by the lookahead score when that finishes
+    bool searched; // True once the lookahead finished inside the time budget
+};
+
+const double AI_GAME_OVER_SCORE = -1e9; // Score of a position where the next piece cannot spawn
+
+// Struct for the AI player
+struct AiPlayer
+{
+    EvalWeights weights;
+    int beamWidth; // Candidates kept for lookahead at each level (0 = greedy only)
+    int lookaheadDepth; // Pieces to look ahead past the current one (1 to AI_MAX_DEPTH)
+    long long timeBudgetUs; // Time allowed per move, in microseconds
+    WorkStealingPool* pool; // Threads for the lookahead, or nullptr to search on the calling thread
+    TranspositionTable* table; // Cache of lookahead values, or nullptr for none
+    long long lastDecisionUs; // Time the last decide() call took, in microseconds
+
+    AiPlayer(WorkStealingPool* pool = nullptr, int beamWidth = 8, long long timeBudgetUs = 2000, int lookaheadDepth = 1, TranspositionTable* table = nullptr)
+        : beamWidth(beamWidth), lookaheadDepth(std::max(1, std::min(lookaheadDepth, AI_MAX_DEPTH))), timeBudgetUs(timeBudgetUs),
+          pool(pool), table(table), lastDecisionUs(0), workers(pool ? pool->size() : 1)
+    {
+        candidates.reserve(MOVEGEN_STATES);
+    }
+
+    // Function to choose a placement for the session's current piece; returns false if the piece has no placement
+    bool decide(const GameSession& session, Placement& best)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point deadline = start + std::chrono::microseconds(timeBudgetUs);
+        int shape = session.currentPiece.shape;
+
+        int n = rootGen.generate(session.board, session.currentPiece, rootList);
+        if (n == 0)
+        {
+            return false;
+        }
+
+        // Greedy score for every placement of the current piece
+        candidates.clear();
+        for (int i = 0; i < n; i++)
+        {
+            AiCandidate c;
+            c.index = i;
+            c.board = afterPlacement(session.board, shape, rootList.items[i], c.lines);
+            c.score = evaluate_board(c.board, c.lines, weights);
+            c.searched = false;
+            candidates.push_back(c);
+        }
+        // Ties keep generation order; std::sort with an index tie-break does this without stable_sort's scratch buffer
+        std::sort(candidates.begin(), candidates.end(), [](const AiCandidate& a, const AiCandidate& b)
+                  { return a.score > b.score || (a.score == b.score && a.index < b.index); });
+
+        // Look ahead from the best few
+        int beam = std::min(beamWidth, n);
+        auto expand = [&](int index, int worker)
+        {
+            AiCandidate& c = candidates[index];
+            double value;
+            if (nodeValue(workers[worker], c.board, lookaheadDepth, deadline, value))
+            {
+                c.score = weights.lines * c.lines + value;
+                c.searched = true;
+            }
+        };
+        if (pool && beam > 1)
+        {
+            pool->parallelFor(beam, expand);
+        }
+        else
+        {
+            for (int i = 0; i < beam; i++)
+            {
+                expand(i, 0);
+            }
+        }
+
+        // Prefer candidates whose lookahead finished; otherwise the greedy order stands
+        int pick = 0;
+        for (int i = 0; i < beam; i++)
+        {
+            if (candidates[i].searched && (!candidates[pick].searched || candidates[i].score > candidates[pick].score))
+            {
+                pick = i;
+            }
+        }
+        best = rootList.items[candidates[pick].index];
+        lastDecisionUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+
+    // Function to steer the current piece to the chosen placement and hard drop it; returns EVENT_* flags
+    int playPiece(GameSession& session)
+    {
+        Placement best;
+        if (!decide(session, best))
+        {
+            return session.apply(ACTION_HARD_DROP);
+        }
+
+        // decide() left the root search in rootGen, so the path can be rebuilt from it
+        int count = rootGen.path(best, path);
+        for (int i = 0; i < count; i++)
+        {
+            session.apply(path[i]);
+        }
+        return session.apply(ACTION_HARD_DROP);
+    }
+
+    // Function to total the transposition table lookups and hits made so far
+    void tableStats(long long& probes, long long& hits) const
+    {
+        probes = 0;
+        hits = 0;
+        for (const AiWorker& w : workers)
+        {
+            probes += w.probes;
+            hits += w.hits;
+        }
+    }
+
+private:
+    std::vector<AiWorker> workers; // One set of buffers per pool thread
+    std::vector<AiCandidate> candidates;
+    MoveGenerator rootGen; // Search for the current piece, kept for rebuilding its path
+    PlacementList rootList;
+    GameAction path[MAX_PATH];
+
+    // Function to get the board left by placing `shape` at `p` and clearing lines
+    static Board afterPlacement(const Board& board, int shape, const Placement& p, int& lines)
+    {
+        Board b = board;
+        b.place(shape_info(shape, p.rotation), p.x, p.y, shape + 1);
+        lines = b.clearFullRows();
+        return b;
+    }
+
+    // Function to work out the value of a board: the average, over the seven possible next pieces, of their best placement.
+    // Returns false if the deadline passed before it finished.
+    bool nodeValue(AiWorker& w, const Board& board, int depth, std::chrono::steady_clock::time_point deadline, double& value)
+    {
+        uint64_t key = board.hash ^ zobrist_depth_key(depth);
+        if (table)
+        {
+            w.probes++;
+            if (table->probe(key, value))
+            {
+                w.hits++;
+                return true;
+            }
+        }
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            return false;
+        }
+
+        PlacementList& list = w.lists[depth];
+        AiChild* children = w.children[depth];
+        double total = 0;
+        for (int next = 0; next < 7; next++)
+        {
+            int n = w.gen.generate(board, Tetromino(next, 0, SPAWN_X, SPAWN_Y), list);
+            if (n == 0)
+            {
+                total += AI_GAME_OVER_SCORE;
+                continue;
+            }
+
+            // Score the placements in batches with the vectorized feature kernel
+            for (int first = 0; first < n; first += FEATURE_BATCH)
+            {
+                int last = std::min(n, first + FEATURE_BATCH);
+                w.batch.count = 0;
+                for (int i = first; i < last; i++)
+                {
+                    children[i].index = i;
+                    w.batch.add(afterPlacement(board, next, list.items[i], children[i].lines));
+                }
+                compute_features(w.batch, w.features);
+                for (int i = first; i < last; i++)
+                {
+                    children[i].score = evaluate_features(w.features, i - first, children[i].lines, weights);
+                }
+            }
+
+            // Deeper levels only expand the best few, scored by what follows them
+            double best = AI_GAME_OVER_SCORE;
+            if (depth == 1)
+            {
+                for (int i = 0; i < n; i++)
+                {
+                    best = std::max(best, children[i].score);
+                }
+            }
+            else
+            {
+                int keep = std::max(1, std::min(beamWidth, n));
+                std::partial_sort(children, children + keep, children + n, [](const AiChild& a, const AiChild& b) { return a.score > b.score; });
+                for (int i = 0; i < keep; i++)
+                {
+                    // Replace the child's static score with the value of what follows it
+                    int lines;
+                    Board b = afterPlacement(board, next, list.items[children[i].index], lines);
+                    double deeper;
+                    if (!nodeValue(w, b, depth - 1, deadline, deeper))
+                    {
+                        return false;
+                    }
+                    best = std::max(best, weights.lines * lines + deeper);
+                }
+            }
+            total += best;
+        }
+
+        value = total / 7;
+        if (table)
+        {
+            table->store(key, value);
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,98 @@
+// ALLOCATION TRACKER //
+// Debug check for the zero-allocation frame loop. When the build defines
+// TETRIS_TRACK_ALLOCS, the global operator new is replaced by one that counts
+// every call from every thread, and AllocFrameCheck aborts the program if a
+// frame after the warm-up allocated anything. Without the macro nothing is
+// replaced and the check does nothing. Only counts C++ allocations; memory
+// that SplashKit's C libraries get with malloc is not seen.
+//
+// The replacement operators must be defined once per program, so include this
+// header from a single translation unit (tetris.cpp).
+
+#ifndef TETRIS_ALLOC_TRACKER_H
+#define TETRIS_ALLOC_TRACKER_H
+
+#include "atomic"
+#include "cstddef"
+#include "cstdio"
+#include "cstdlib"
+#include "new"
+
+inline std::atomic<long long> ALLOC_COUNT(0); // operator new calls so far (only counted with TETRIS_TRACK_ALLOCS)
+
+#ifdef TETRIS_TRACK_ALLOCS
+
+// Function to allocate and count a block, shared by every replaced operator new
+inline void* tracked_alloc(std::size_t size, std::size_t alignment)
+{
+    ALLOC_COUNT.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0)
+    {
+        size = 1;
+    }
+    void* p = nullptr;
+    if (alignment <= alignof(std::max_align_t))
+    {
+        p = std::malloc(size);
+    }
+    else
+    {
+        // aligned_alloc needs the size to be a multiple of the alignment
+        p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    }
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new(std::size_t size) { return tracked_alloc(size, 0); }
+void* operator new[](std::size_t size) { return tracked_alloc(size, 0); }
+void* operator new(std::size_t size, std::align_val_t al) { return tracked_alloc(size, static_cast<std::size_t>(al)); }
+void* operator new[](std::size_t size, std::align_val_t al) { return tracked_alloc(size, static_cast<std::size_t>(al)); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+#endif
+
+// Struct for checking that frames after the warm-up do not allocate
+struct AllocFrameCheck
+{
+    int warmupFrames; // Frames allowed to allocate while fonts, sounds and caches load
+    int frame; // Frames finished so far
+    long long lastCount; // ALLOC_COUNT at the end of the previous frame
+    bool excused; // Set when this frame did something rare that is allowed to allocate
+
+    explicit AllocFrameCheck(int warmupFrames = 120) : warmupFrames(warmupFrames), frame(0), lastCount(0), excused(false) {}
+
+    // Function to let the current frame allocate (saving the high score, starting a game)
+    void excuse()
+    {
+        excused = true;
+    }
+
+    // Function to call once at the end of every frame; aborts if the frame allocated after the warm-up
+    void endFrame()
+    {
+#ifdef TETRIS_TRACK_ALLOCS
+        long long count = ALLOC_COUNT.load(std::memory_order_relaxed);
+        if (frame >= warmupFrames && !excused && count != lastCount)
+        {
+            fprintf(stderr, "frame %d made %lld heap allocations\n", frame, count - lastCount);
+            std::abort();
+        }
+        lastCount = count;
+#endif
+        excused = false;
+        frame++;
+    }
+};
+
+#endif
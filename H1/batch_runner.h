@@ -0,0 +1,158 @@
+// BATCH SELF-PLAY RUNNER //
+// Plays many independent seeded games across a WorkStealingPool. Each game's
+// seed comes only from the batch seed and the game's index, so a batch gives
+// the same results whatever the thread count. Each worker keeps its own
+// session and counters, so nothing is shared while games are running.
+
+#ifndef TETRIS_BATCH_RUNNER_H
+#define TETRIS_BATCH_RUNNER_H
+
+#include "algorithm"
+#include "chrono"
+#include "cstdint"
+#include "vector"
+#include "game_session.h"
+#include "thread_pool.h"
+
+// Function to derive an independent seed for one game of a batch (a splitmix64 step)
+inline uint32_t game_seed(uint64_t batchSeed, int gameIndex)
+{
+    return static_cast<uint32_t>(mix64(batchSeed + RANDOM_GAMMA * (static_cast<uint64_t>(gameIndex) + 1))) | 1;
+}
+
+// Struct for a player that drops each piece at a random rotation and column
+struct RandomPlayer
+{
+    uint32_t rng;
+
+    explicit RandomPlayer(uint32_t seed) : rng(seed ? seed : 1) {}
+
+    // Function to pick a random number in [0, n)
+    int next(int n)
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return static_cast<int>(rng % static_cast<uint32_t>(n));
+    }
+
+    // Function to steer the current piece to a random rotation and column, then hard drop it; returns EVENT_* flags
+    template <typename Session>
+    int playPiece(Session& session)
+    {
+        int turns = next(4);
+        for (int i = 0; i < turns; i++)
+        {
+            session.apply(ACTION_ROTATE);
+        }
+
+        int shift = next(Session::WIDTH) - session.currentPiece.pos.x;
+        for (int i = 0; i < shift; i++)
+        {
+            session.apply(ACTION_MOVE_RIGHT);
+        }
+        for (int i = 0; i > shift; i--)
+        {
+            session.apply(ACTION_MOVE_LEFT);
+        }
+        return session.apply(ACTION_HARD_DROP);
+    }
+};
+
+// Struct for the combined results of a batch
+struct BatchReport
+{
+    int games;
+    long long pieces;
+    long long lines;
+    double seconds;
+    std::vector<int> scores; // Final score of every game, sorted ascending
+
+    BatchReport() : games(0), pieces(0), lines(0), seconds(0) {}
+
+    double gamesPerSecond() const
+    {
+        return seconds > 0 ? games / seconds : 0;
+    }
+
+    double piecesPerSecond() const
+    {
+        return seconds > 0 ? pieces / seconds : 0;
+    }
+
+    double meanScore() const
+    {
+        double total = 0;
+        for (int s : scores)
+        {
+            total += s;
+        }
+        return scores.empty() ? 0 : total / scores.size();
+    }
+
+    // Function to get the score at percentile p (0 to 100)
+    int percentile(double p) const
+    {
+        if (scores.empty())
+        {
+            return 0;
+        }
+        size_t i = static_cast<size_t>(p / 100.0 * (scores.size() - 1) + 0.5);
+        return scores[std::min(i, scores.size() - 1)];
+    }
+};
+
+// Struct for one worker's private state, padded so workers never share a cache line
+struct alignas(64) BatchWorker
+{
+    GameSession session;
+    long long pieces;
+    long long lines;
+
+    BatchWorker() : pieces(0), lines(0) {}
+};
+
+// Function to play `games` games, each for at most maxPieces pieces; makePlayer(seed) builds each game's player
+template <typename MakePlayer>
+BatchReport run_batch(WorkStealingPool& pool, int games, uint64_t seed, int maxPieces, MakePlayer makePlayer,
+                      RandomizerKind randomizer = RANDOMIZER_UNIFORM)
+{
+    BatchReport report;
+    report.games = games;
+    report.scores.assign(games, 0);
+
+    std::vector<BatchWorker> workers(pool.size());
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    pool.parallelFor(games, [&](int index, int worker)
+    {
+        BatchWorker& w = workers[worker];
+        GameSession& session = w.session;
+        uint32_t s = game_seed(seed, index);
+        session.randomizer.kind = static_cast<uint8_t>(randomizer);
+        session.reset(1, s);
+        auto player = makePlayer(s ^ 0x5BD1E995u);
+
+        int pieces = 0;
+        while (!session.gameOver && pieces < maxPieces)
+        {
+            player.playPiece(session);
+            pieces++;
+        }
+
+        w.pieces += pieces;
+        w.lines += session.stats.linesCleared;
+        report.scores[index] = session.stats.score;
+    });
+
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (const BatchWorker& w : workers)
+    {
+        report.pieces += w.pieces;
+        report.lines += w.lines;
+    }
+    std::sort(report.scores.begin(), report.scores.end());
+    return report;
+}
+
+#endif
@@ -0,0 +1,281 @@
+// BOARD ENGINE //
+// Occupancy is stored as one bit per cell and one word per row, so collision,
+// locking and full-row detection are mask operations. Cell colours live in a
+// separate array that only the renderer reads. The board is a template on its
+// width and height: the row word is the smallest of 16, 32 or 64 bits that
+// holds a row, and every loop bound, mask and key table is a compile-time
+// constant of the size, so a 64x128 board compiles to the same kind of code
+// as the classic 10x20 one. Board is the classic size.
+
+#ifndef TETRIS_BOARD_H
+#define TETRIS_BOARD_H
+
+#include "cstdint"
+#include "cstring"
+#include "type_traits"
+#include "shapes.h"
+#include "zobrist.h"
+
+const int GRID_WIDTH = 10; // Number of columns in the grid
+const int GRID_HEIGHT = 20; // Number of rows in the grid
+
+// The smallest unsigned word that holds a row of W columns
+template <int W>
+using RowWord = typename std::conditional<(W <= 16), uint16_t, typename std::conditional<(W <= 32), uint32_t, uint64_t>::type>::type;
+
+// Signed type for column heights of a board H rows tall
+template <int H>
+using HeightWord = typename std::conditional<(H <= 127), int8_t, int16_t>::type;
+
+// Function to count the filled cells in a row word; uses the popcnt instruction when the build allows it
+inline int row_popcount(uint32_t bits)
+{
+#if defined(__POPCNT__)
+    return __builtin_popcount(bits);
+#else
+    // Without popcnt the builtin becomes a library call, so count with bit tricks instead
+    bits = bits - ((bits >> 1) & 0x55555555u);
+    bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+    bits = (bits + (bits >> 4)) & 0x0F0F0F0Fu;
+    return static_cast<int>((bits * 0x01010101u) >> 24);
+#endif
+}
+
+// Function to get the index of the lowest set bit of a row word (bits must not be 0)
+template <typename T>
+inline int row_lowest_bit(T bits)
+{
+    if constexpr (sizeof(T) > 4)
+    {
+        return __builtin_ctzll(bits);
+    }
+    else
+    {
+        return __builtin_ctz(bits);
+    }
+}
+
+// Struct for a game board of W columns and H rows
+template <int W, int H>
+struct BasicBoard
+{
+    static_assert(W >= 4 && W <= 64, "A row must hold a piece and fit in a 64-bit word");
+    static_assert(H >= 4 && H <= 255, "Column heights must fit in a HeightWord");
+
+    typedef RowWord<W> Row; // One row of the board, bit x is column x
+    typedef HeightWord<H> Height;
+    static constexpr int WIDTH = W;
+    static constexpr int HEIGHT = H;
+    static constexpr Row FULL = static_cast<Row>(static_cast<Row>(~Row(0)) >> (8 * sizeof(Row) - W)); // A row with every column filled
+    static constexpr ZobristKeys<W, H> KEYS = make_zobrist_keys<W, H>(); // Zobrist key of each cell
+
+    Row rows[H]; // Occupancy bits, one word per row
+    uint8_t colors[H][W]; // Shape index + 1 for each cell, 0 if empty (rendering only)
+    uint64_t hash; // Zobrist hash of the filled cells, kept up to date by place() and clearFullRows()
+    Height heights[W]; // Skyline: rows from the floor to each column's top filled cell, 0 if empty
+
+    BasicBoard()
+    {
+        clear();
+    }
+
+    // Function to empty the whole board
+    void clear()
+    {
+        memset(rows, 0, sizeof(rows));
+        memset(colors, 0, sizeof(colors));
+        hash = 0;
+        memset(heights, 0, sizeof(heights));
+    }
+
+    // Function to get the XOR of the Zobrist keys of the filled cells in one row
+    static uint64_t rowHash(int y, Row bits)
+    {
+        uint64_t h = 0;
+        for (; bits; bits &= bits - 1)
+        {
+            h ^= KEYS.cells[y][row_lowest_bit(bits)];
+        }
+        return h;
+    }
+
+    // Function to get the colour index of a cell (0 = empty)
+    int cell(int x, int y) const
+    {
+        return colors[y][x];
+    }
+
+    // Checks if a shape rotation with its 4x4 grid placed at (x, y) hits a wall, the floor or a filled cell
+    bool collides(const ShapeInfo& shape, int x, int y) const
+    {
+        // Walls and floor are a single extent check
+        int left = x + shape.minX;
+        if (left < 0 || x + shape.maxX >= W || y + shape.maxY >= H)
+        {
+            return true;
+        }
+
+        // Then one AND per row of the shape
+        for (int r = shape.minY; r <= shape.maxY; r++)
+        {
+            int by = y + r; // Board row index
+            if (by >= 0 && (rows[by] & (Row(shape.rowMasks[r]) << left)))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Function to write a shape rotation into the board (the position must not collide)
+    void place(const ShapeInfo& shape, int x, int y, int colorIndex)
+    {
+        int left = x + shape.minX;
+        for (int r = shape.minY; r <= shape.maxY; r++)
+        {
+            // Only lock cells within the visible board
+            if (y + r >= 0)
+            {
+                rows[y + r] |= static_cast<Row>(Row(shape.rowMasks[r]) << left);
+            }
+        }
+        for (int i = 0; i < 4; i++)
+        {
+            int by = y + shape.cells[i].y;
+            int bx = x + shape.cells[i].x;
+            if (by >= 0)
+            {
+                colors[by][bx] = static_cast<uint8_t>(colorIndex);
+                hash ^= KEYS.cells[by][bx];
+                if (H - by > heights[bx])
+                {
+                    heights[bx] = static_cast<Height>(H - by);
+                }
+            }
+        }
+    }
+
+    // Function to get how many rows a shape rotation at (x, y) can fall before it lands (the position must not collide)
+    int dropDistance(const ShapeInfo& shape, int x, int y) const
+    {
+        // While the piece is above the skyline in every column it covers, each column's gap is just
+        // the distance from the piece's lowest cell to that column's top filled cell
+        int drop = H;
+        for (int c = shape.minX; c <= shape.maxX; c++)
+        {
+            int bottom = y + shape.bottom[c]; // Board row of the piece's lowest cell in this column
+            int top = H - heights[x + c]; // Board row of the column's top filled cell (or the floor)
+            if (bottom >= top)
+            {
+                return scanDropDistance(shape, x, y); // Tucked under an overhang: the skyline can't tell
+            }
+            if (top - 1 - bottom < drop)
+            {
+                drop = top - 1 - bottom;
+            }
+        }
+        return drop;
+    }
+
+    // Function to find the drop distance by testing one row at a time (used under overhangs)
+    int scanDropDistance(const ShapeInfo& shape, int x, int y) const
+    {
+        int drop = 0;
+        while (!collides(shape, x, y + drop + 1))
+        {
+            drop++;
+        }
+        return drop;
+    }
+
+    // Function to get the highest row with a filled cell, from the skyline (H if the board is empty)
+    int stackTop() const
+    {
+        int tallest = 0;
+        for (int x = 0; x < W; x++)
+        {
+            tallest = heights[x] > tallest ? heights[x] : tallest;
+        }
+        return H - tallest;
+    }
+
+    // Function to rebuild the skyline from the rows, scanning down from the top of the stack only until every column's top is found
+    void recomputeHeights(int top = 0)
+    {
+        memset(heights, 0, sizeof(heights));
+        Row covered = 0;
+        for (int y = top; y < H && covered != FULL; y++)
+        {
+            for (Row tops = rows[y] & ~covered; tops; tops &= tops - 1)
+            {
+                heights[row_lowest_bit(tops)] = static_cast<Height>(H - y);
+            }
+            covered |= rows[y];
+        }
+    }
+
+    // Function to remove every full row, moving the rows above down; returns the number of rows removed.
+    // If only rows first..last can be full (the rows a piece was just placed in), the search for full rows
+    // is limited to them. Rows above the stack are empty, so the rest of the work is bounded by the stack's
+    // height rather than the board's.
+    int clearFullRows(int first = 0, int last = H - 1)
+    {
+        // Only rows at or above the lowest full row move, so only their hash changes
+        int lowest = last < H - 1 ? last : H - 1;
+        int highest = first > 0 ? first : 0;
+        while (lowest >= highest && rows[lowest] != FULL)
+        {
+            lowest--;
+        }
+        if (lowest < highest)
+        {
+            return 0;
+        }
+        int top = stackTop();
+        for (int y = top; y <= lowest; y++)
+        {
+            hash ^= rowHash(y, rows[y]);
+        }
+
+        int lines = 0;
+        int write = lowest;
+
+        // Compact the non-full rows towards the bottom in a single pass
+        for (int read = lowest; read >= top; read--)
+        {
+            if (rows[read] == FULL)
+            {
+                lines++;
+                continue;
+            }
+            if (write != read)
+            {
+                rows[write] = rows[read];
+                memcpy(colors[write], colors[read], W);
+            }
+            write--;
+        }
+
+        // Empty the rows left at the top of the old stack
+        for (; write >= top; write--)
+        {
+            rows[write] = 0;
+            memset(colors[write], 0, W);
+        }
+
+        for (int y = top; y <= lowest; y++)
+        {
+            hash ^= rowHash(y, rows[y]);
+        }
+        recomputeHeights(top + lines);
+        return lines;
+    }
+};
+
+// The classic board
+typedef BasicBoard<GRID_WIDTH, GRID_HEIGHT> Board;
+typedef Board::Row RowBits;
+const RowBits FULL_ROW = Board::FULL;
+constexpr const ZobristKeys<GRID_WIDTH, GRID_HEIGHT>& BOARD_KEYS = Board::KEYS; // Zobrist key of each cell
+
+#endif
@@ -0,0 +1,258 @@
+// BATCH BOARD FEATURES //
+// Computes evaluation features for many boards at once. Boards are stored
+// structure-of-arrays: rows[y][lane] holds row y of board `lane`, so one
+// vector register holds the same row of 16 (AVX2) or 8 (SSE4.1) boards and
+// every feature is a few bitwise ops and popcounts per row. Builds without
+// those instruction sets use a scalar loop with the same results. Pick the
+// instruction set at compile time, e.g. -mavx2 or -march=native.
+//
+// Features per board:
+//   heights            column heights (rows from the floor to the top filled cell)
+//   aggregateHeight    sum of column heights
+//   holes              empty cells with a filled cell somewhere above them
+//   bumpiness          sum of |height difference| between neighbouring columns
+//   rowTransitions     filled/empty changes along each row, walls count as filled
+//   columnTransitions  filled/empty changes down each column, floor counts as filled
+//   wells              empty cells whose left and right neighbours are filled (walls count)
+
+#ifndef TETRIS_EVAL_FEATURES_H
+#define TETRIS_EVAL_FEATURES_H
+
+#include "cstdint"
+#include "cstring"
+#include "board.h"
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include "immintrin.h"
+#endif
+
+const int FEATURE_BATCH = 16; // Boards per batch (one AVX2 register of 16-bit lanes)
+
+// Row transitions add a wall bit on each side of the row, which must still fit in 16-bit lanes
+static_assert(GRID_WIDTH + 2 <= 16, "Batch features need rows of at most 14 columns");
+
+// Struct for a batch of boards in structure-of-arrays layout
+struct alignas(32) BoardBatch
+{
+    uint16_t rows[GRID_HEIGHT][FEATURE_BATCH];
+    int count; // Lanes in use
+
+    BoardBatch() : count(0)
+    {
+        memset(rows, 0, sizeof(rows));
+    }
+
+    // Function to empty the batch
+    void clear()
+    {
+        memset(rows, 0, sizeof(rows));
+        count = 0;
+    }
+
+    // Function to copy a board into the next free lane; returns the lane index
+    int add(const Board& board)
+    {
+        int lane = count++;
+        for (int y = 0; y < GRID_HEIGHT; y++)
+        {
+            rows[y][lane] = board.rows[y];
+        }
+        return lane;
+    }
+};
+
+// Struct for the features of every board in a batch, one array entry per lane
+struct alignas(32) FeatureBatch
+{
+    int16_t heights[GRID_WIDTH][FEATURE_BATCH];
+    int16_t aggregateHeight[FEATURE_BATCH];
+    int16_t holes[FEATURE_BATCH];
+    int16_t bumpiness[FEATURE_BATCH];
+    int16_t rowTransitions[FEATURE_BATCH];
+    int16_t columnTransitions[FEATURE_BATCH];
+    int16_t wells[FEATURE_BATCH];
+};
+
+// Function to compute the features of one lane with plain integer code
+inline void compute_features_scalar(const BoardBatch& batch, int lane, FeatureBatch& out)
+{
+    const uint32_t walls = 1u | (1u << (GRID_WIDTH + 1)); // Wall bits around a row shifted left by one
+    uint32_t covered = 0;
+    uint32_t prev = 0; // Row above the current one; above the board counts as empty
+    int heights[GRID_WIDTH] = {0};
+    int agg = 0, holes = 0, rowT = 0, colT = 0, wells = 0;
+
+    for (int y = 0; y < GRID_HEIGHT; y++)
+    {
+        uint32_t row = batch.rows[y][lane];
+        holes += row_popcount(covered & ~row);
+
+        // Columns whose top cell is in this row get their height here
+        for (uint32_t tops = row & ~covered; tops; tops &= tops - 1)
+        {
+            heights[__builtin_ctz(tops)] = GRID_HEIGHT - y;
+        }
+        covered |= row;
+        agg += row_popcount(covered);
+
+        uint32_t walled = (row << 1) | walls;
+        rowT += row_popcount((walled ^ (walled >> 1)) & ((1u << (GRID_WIDTH + 1)) - 1));
+        colT += row_popcount(row ^ prev);
+        uint32_t left = (row << 1) | 1u;
+        uint32_t right = (row >> 1) | (1u << (GRID_WIDTH - 1));
+        wells += row_popcount(~row & left & right & FULL_ROW);
+        prev = row;
+    }
+    colT += row_popcount(~prev & FULL_ROW);
+
+    int bump = 0;
+    for (int c = 0; c < GRID_WIDTH; c++)
+    {
+        out.heights[c][lane] = static_cast<int16_t>(heights[c]);
+        if (c + 1 < GRID_WIDTH)
+        {
+            bump += heights[c] > heights[c + 1] ? heights[c] - heights[c + 1] : heights[c + 1] - heights[c];
+        }
+    }
+    out.aggregateHeight[lane] = static_cast<int16_t>(agg);
+    out.holes[lane] = static_cast<int16_t>(holes);
+    out.bumpiness[lane] = static_cast<int16_t>(bump);
+    out.rowTransitions[lane] = static_cast<int16_t>(rowT);
+    out.columnTransitions[lane] = static_cast<int16_t>(colT);
+    out.wells[lane] = static_cast<int16_t>(wells);
+}
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+
+// Vector operations on 16-bit lanes, so one kernel serves both instruction sets
+#if defined(__AVX2__)
+typedef __m256i FeatureVec;
+inline FeatureVec fv_load(const void* p) { return _mm256_load_si256(static_cast<const __m256i*>(p)); }
+inline void fv_store(void* p, FeatureVec v) { _mm256_store_si256(static_cast<__m256i*>(p), v); }
+inline FeatureVec fv_set(int x) { return _mm256_set1_epi16(static_cast<short>(x)); }
+inline FeatureVec fv_zero() { return _mm256_setzero_si256(); }
+inline FeatureVec fv_and(FeatureVec a, FeatureVec b) { return _mm256_and_si256(a, b); }
+inline FeatureVec fv_andnot(FeatureVec a, FeatureVec b) { return _mm256_andnot_si256(a, b); } // ~a & b
+inline FeatureVec fv_or(FeatureVec a, FeatureVec b) { return _mm256_or_si256(a, b); }
+inline FeatureVec fv_xor(FeatureVec a, FeatureVec b) { return _mm256_xor_si256(a, b); }
+inline FeatureVec fv_add(FeatureVec a, FeatureVec b) { return _mm256_add_epi16(a, b); }
+inline FeatureVec fv_sub(FeatureVec a, FeatureVec b) { return _mm256_sub_epi16(a, b); }
+inline FeatureVec fv_abs(FeatureVec a) { return _mm256_abs_epi16(a); }
+inline FeatureVec fv_cmpeq(FeatureVec a, FeatureVec b) { return _mm256_cmpeq_epi16(a, b); }
+inline FeatureVec fv_shl1(FeatureVec a) { return _mm256_slli_epi16(a, 1); }
+inline FeatureVec fv_shr1(FeatureVec a) { return _mm256_srli_epi16(a, 1); }
+inline FeatureVec fv_popcount(FeatureVec v)
+{
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(v, nibble)),
+                                    _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble)));
+    return _mm256_add_epi16(_mm256_and_si256(bytes, _mm256_set1_epi16(0x00FF)), _mm256_srli_epi16(bytes, 8));
+}
+#else
+typedef __m128i FeatureVec;
+inline FeatureVec fv_load(const void* p) { return _mm_load_si128(static_cast<const __m128i*>(p)); }
+inline void fv_store(void* p, FeatureVec v) { _mm_store_si128(static_cast<__m128i*>(p), v); }
+inline FeatureVec fv_set(int x) { return _mm_set1_epi16(static_cast<short>(x)); }
+inline FeatureVec fv_zero() { return _mm_setzero_si128(); }
+inline FeatureVec fv_and(FeatureVec a, FeatureVec b) { return _mm_and_si128(a, b); }
+inline FeatureVec fv_andnot(FeatureVec a, FeatureVec b) { return _mm_andnot_si128(a, b); } // ~a & b
+inline FeatureVec fv_or(FeatureVec a, FeatureVec b) { return _mm_or_si128(a, b); }
+inline FeatureVec fv_xor(FeatureVec a, FeatureVec b) { return _mm_xor_si128(a, b); }
+inline FeatureVec fv_add(FeatureVec a, FeatureVec b) { return _mm_add_epi16(a, b); }
+inline FeatureVec fv_sub(FeatureVec a, FeatureVec b) { return _mm_sub_epi16(a, b); }
+inline FeatureVec fv_abs(FeatureVec a) { return _mm_abs_epi16(a); }
+inline FeatureVec fv_cmpeq(FeatureVec a, FeatureVec b) { return _mm_cmpeq_epi16(a, b); }
+inline FeatureVec fv_shl1(FeatureVec a) { return _mm_slli_epi16(a, 1); }
+inline FeatureVec fv_shr1(FeatureVec a) { return _mm_srli_epi16(a, 1); }
+inline FeatureVec fv_popcount(FeatureVec v)
+{
+    const __m128i lut = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i bytes = _mm_add_epi8(_mm_shuffle_epi8(lut, _mm_and_si128(v, nibble)),
+                                 _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), nibble)));
+    return _mm_add_epi16(_mm_and_si128(bytes, _mm_set1_epi16(0x00FF)), _mm_srli_epi16(bytes, 8));
+}
+#endif
+
+const int FEATURE_LANES = static_cast<int>(sizeof(FeatureVec) / sizeof(uint16_t)); // Boards per register
+
+// Function to compute the features of the FEATURE_LANES boards starting at `lane`
+inline void compute_features_simd(const BoardBatch& batch, int lane, FeatureBatch& out)
+{
+    const FeatureVec full = fv_set(FULL_ROW);
+    const FeatureVec one = fv_set(1);
+    const FeatureVec walls = fv_set(1 | (1 << (GRID_WIDTH + 1)));
+    const FeatureVec rowSpan = fv_set((1 << (GRID_WIDTH + 1)) - 1);
+    const FeatureVec rightWall = fv_set(1 << (GRID_WIDTH - 1));
+
+    FeatureVec covered = fv_zero(), prev = fv_zero();
+    FeatureVec agg = fv_zero(), holes = fv_zero(), rowT = fv_zero(), colT = fv_zero(), wells = fv_zero();
+    FeatureVec heights[GRID_WIDTH];
+    FeatureVec columnBits[GRID_WIDTH];
+    for (int c = 0; c < GRID_WIDTH; c++)
+    {
+        heights[c] = fv_zero();
+        columnBits[c] = fv_set(1 << c);
+    }
+
+    for (int y = 0; y < GRID_HEIGHT; y++)
+    {
+        FeatureVec row = fv_load(&batch.rows[y][lane]);
+        holes = fv_add(holes, fv_popcount(fv_andnot(row, covered)));
+        covered = fv_or(covered, row);
+        agg = fv_add(agg, fv_popcount(covered));
+
+        // A covered column compares equal to its bit (-1), so subtracting adds one to its height
+        for (int c = 0; c < GRID_WIDTH; c++)
+        {
+            heights[c] = fv_sub(heights[c], fv_cmpeq(fv_and(covered, columnBits[c]), columnBits[c]));
+        }
+
+        FeatureVec walled = fv_or(fv_shl1(row), walls);
+        rowT = fv_add(rowT, fv_popcount(fv_and(fv_xor(walled, fv_shr1(walled)), rowSpan)));
+        colT = fv_add(colT, fv_popcount(fv_xor(row, prev)));
+        FeatureVec left = fv_or(fv_shl1(row), one);
+        FeatureVec right = fv_or(fv_shr1(row), rightWall);
+        wells = fv_add(wells, fv_popcount(fv_and(fv_andnot(row, full), fv_and(left, right))));
+        prev = row;
+    }
+    colT = fv_add(colT, fv_popcount(fv_andnot(prev, full)));
+
+    FeatureVec bump = fv_zero();
+    for (int c = 0; c < GRID_WIDTH; c++)
+    {
+        fv_store(&out.heights[c][lane], heights[c]);
+        if (c + 1 < GRID_WIDTH)
+        {
+            bump = fv_add(bump, fv_abs(fv_sub(heights[c], heights[c + 1])));
+        }
+    }
+    fv_store(&out.aggregateHeight[lane], agg);
+    fv_store(&out.holes[lane], holes);
+    fv_store(&out.bumpiness[lane], bump);
+    fv_store(&out.rowTransitions[lane], rowT);
+    fv_store(&out.columnTransitions[lane], colT);
+    fv_store(&out.wells[lane], wells);
+}
+
+#endif
+
+// Function to compute the features of every board in the batch (results for lanes past batch.count are meaningless)
+inline void compute_features(const BoardBatch& batch, FeatureBatch& out)
+{
+#if defined(__AVX2__) || defined(__SSE4_1__)
+    for (int lane = 0; lane < batch.count; lane += FEATURE_LANES)
+    {
+        compute_features_simd(batch, lane, out);
+    }
+#else
+    for (int lane = 0; lane < batch.count; lane++)
+    {
+        compute_features_scalar(batch, lane, out);
+    }
+#endif
+}
+
+#endif
@@ -0,0 +1,342 @@
+// GAME SESSION //
+// The rules of the game with no window, rendering or audio. A session is
+// driven through apply() for player actions and tick() once per fixed 60 Hz
+// simulation step, and reports what happened through EVENT_* flags so the
+// front end can play sounds or update the UI. Sessions share nothing, so any
+// number can run at once on any threads. Like the board, a session is a
+// template on the board size; GameSession is the classic 10x20 game.
+
+#ifndef TETRIS_GAME_SESSION_H
+#define TETRIS_GAME_SESSION_H
+
+#include "algorithm"
+#include "cstdint"
+#include "type_traits"
+#include "board.h"
+#include "randomizer.h"
+
+const int MAX_LEVEL = 5; // Maximum selectable starting level
+const int SPAWN_X = (GRID_WIDTH - 4) / 2; // Column of the 4x4 grid of a newly spawned piece on the classic board
+const int SPAWN_Y = 0; // Row of the 4x4 grid of a newly spawned piece
+
+// STRUCTS
+// Struct for position on the grid
+struct Position
+{
+    int x, y;
+    Position(int x = 0, int y = 0) : x(x), y(y) {}
+};
+
+// Struct for tetromino details
+struct Tetromino
+{
+    int shape;      // Shape index
+    int rotation;   // Rotation index
+    Position pos;   // Top-left position of the 4x4 tetromino grid
+
+    Tetromino(int shape = 0, int rotation = 0, int x = 3, int y = 0) : shape(shape), rotation(rotation), pos(x, y) {}
+};
+
+// Struct for game stats
+struct GameStats
+{
+    int score;
+    int level;
+    int linesCleared;
+    double gameTime;
+
+    GameStats() : score(0), level(1), linesCleared(0), gameTime(0) {}
+
+    // Reset stats for a new game, starting at a given level
+    void reset(int startLevel)
+    {
+        score = 0;
+        level = startLevel;
+        linesCleared = 0;
+        gameTime = 0;
+    }
+};
+
+// Player actions a session understands
+enum GameAction
+{
+    ACTION_MOVE_LEFT,
+    ACTION_MOVE_RIGHT,
+    ACTION_ROTATE,
+    ACTION_SOFT_DROP,
+    ACTION_HARD_DROP
+};
+
+// Flags returned by apply() and tick() describing what happened
+const int EVENT_PIECE_LOCKED = 1 << 0;
+const int EVENT_LINES_CLEARED = 1 << 1;
+const int EVENT_GAME_OVER = 1 << 2;
+
+// Kinds of input a session reports to its observer
+enum SessionInput
+{
+    SESSION_ACTION, // apply() was called; value is the GameAction
+    SESSION_TICK, // tick() was called; value is 1 if soft drop was held
+    SESSION_SPAWN, // A new piece spawned; value is its shape
+    SESSION_RESTORE // restore() replaced the whole state; value is 0
+};
+
+// Function type for watching everything that drives a session (used to record replays)
+typedef void (*SessionObserver)(void* context, int input, int value);
+
+// Struct for a flat copy of everything a session's future depends on (about 360 bytes for the classic board).
+// It holds no pointers, so saving or restoring one is a plain copy.
+template <int W, int H>
+struct BasicGameSnapshot
+{
+    BasicBoard<W, H> board;
+    Tetromino currentPiece;
+    GameStats stats;
+    int startLevel;
+    int dropTimer;
+    bool gameOver;
+    PieceRandomizer randomizer;
+};
+
+typedef BasicGameSnapshot<GRID_WIDTH, GRID_HEIGHT> GameSnapshot;
+
+static_assert(std::is_trivially_copyable<GameSnapshot>::value, "Snapshots must be copyable with memcpy");
+
+// Struct holding one complete game on a board of W columns and H rows
+template <int W, int H>
+struct BasicGameSession
+{
+    typedef BasicBoard<W, H> BoardType;
+    typedef BasicGameSnapshot<W, H> Snapshot;
+    static constexpr int WIDTH = W;
+    static constexpr int HEIGHT = H;
+    static constexpr int SPAWN_COLUMN = (W - 4) / 2; // Column of the 4x4 grid of a newly spawned piece
+
+    BoardType board; // The locked cells
+    Tetromino currentPiece; // The currently falling tetromino
+    GameStats stats; // Score, level, lines and time
+    int startLevel; // Level the game was started at
+    int dropTimer; // Counts ticks for automatic drop
+    bool gameOver; // Set once a new piece cannot spawn
+    PieceRandomizer randomizer; // This session's piece sequence; set randomizer.kind before reset() to pick the rule
+    int highScore; // Best score known across games; not in snapshots, so a restore never takes it back
+    int ghostRow; // Cached landing row of the current piece
+    bool ghostValid; // False once the piece moves sideways, rotates or is replaced
+    SessionObserver observer; // Told about every action, tick and spawn, or nullptr
+    void* observerContext;
+
+    BasicGameSession() : startLevel(1), dropTimer(0), gameOver(false), highScore(0), ghostRow(0), ghostValid(false), observer(nullptr), observerContext(nullptr) {}
+
+    // Function to start a new game at the given level with the given random seed
+    void reset(int level, uint32_t seed)
+    {
+        board.clear();
+        stats.reset(level);
+        startLevel = level;
+        dropTimer = 0;
+        gameOver = false;
+        randomizer.reset(seed, static_cast<RandomizerKind>(randomizer.kind));
+        spawn();
+    }
+
+    // Function to copy the session's state into a snapshot
+    void save(Snapshot& out) const
+    {
+        out.board = board;
+        out.currentPiece = currentPiece;
+        out.stats = stats;
+        out.startLevel = startLevel;
+        out.dropTimer = dropTimer;
+        out.gameOver = gameOver;
+        out.randomizer = randomizer;
+    }
+
+    // Function to put the session back into a saved state (the observer is kept and told)
+    void restore(const Snapshot& in)
+    {
+        board = in.board;
+        currentPiece = in.currentPiece;
+        stats = in.stats;
+        startLevel = in.startLevel;
+        dropTimer = in.dropTimer;
+        gameOver = in.gameOver;
+        randomizer = in.randomizer;
+        ghostValid = false;
+        if (observer)
+        {
+            observer(observerContext, SESSION_RESTORE, 0);
+        }
+    }
+
+    // Function to get the Zobrist hash of the whole position: locked cells plus the falling piece
+    uint64_t hash() const
+    {
+        return board.hash ^ zobrist_piece_key(currentPiece.shape, currentPiece.rotation, currentPiece.pos.x, currentPiece.pos.y);
+    }
+
+    // Checks if the given tetromino fits on the board
+    bool fits(const Tetromino& piece) const
+    {
+        return !board.collides(shape_info(piece.shape, piece.rotation), piece.pos.x, piece.pos.y);
+    }
+
+    // Function to move or rotate the current piece if the result fits; returns true if it moved
+    bool tryMove(int dx, int dy, int rotation)
+    {
+        Tetromino moved(currentPiece.shape, rotation, currentPiece.pos.x + dx, currentPiece.pos.y + dy);
+        if (!fits(moved))
+        {
+            return false;
+        }
+
+        // Moving straight down keeps the same landing row
+        if (dx != 0 || rotation != currentPiece.rotation)
+        {
+            ghostValid = false;
+        }
+        currentPiece = moved;
+        return true;
+    }
+
+    // Function to apply one player action; returns EVENT_* flags
+    int apply(GameAction action)
+    {
+        if (gameOver)
+        {
+            return 0;
+        }
+        if (observer)
+        {
+            observer(observerContext, SESSION_ACTION, action);
+        }
+
+        switch (action)
+        {
+            case ACTION_MOVE_LEFT:
+                tryMove(-1, 0, currentPiece.rotation);
+                break;
+            case ACTION_MOVE_RIGHT:
+                tryMove(1, 0, currentPiece.rotation);
+                break;
+            case ACTION_ROTATE:
+                tryMove(0, 0, (currentPiece.rotation + 1) % 4);
+                break;
+            case ACTION_SOFT_DROP:
+                tryMove(0, 1, currentPiece.rotation);
+                break;
+            case ACTION_HARD_DROP:
+                // Move piece straight to its landing row, then lock it
+                currentPiece.pos.y = ghostY();
+                return lockPiece();
+        }
+        return 0;
+    }
+
+    // Function to advance the game by one frame of gravity; soft drop applies while softDrop is held
+    int tick(bool softDrop)
+    {
+        if (gameOver)
+        {
+            return 0;
+        }
+        if (observer)
+        {
+            observer(observerContext, SESSION_TICK, softDrop ? 1 : 0);
+        }
+
+        // While soft drop is held, move the piece down every 5 ticks
+        if (softDrop && dropTimer % 5 == 0)
+        {
+            tryMove(0, 1, currentPiece.rotation);
+        }
+
+        dropTimer++;
+
+        // When the drop timer reaches the current drop delay, move down one row or lock
+        if (dropTimer >= dropDelay())
+        {
+            dropTimer = 0;
+            if (!tryMove(0, 1, currentPiece.rotation))
+            {
+                return lockPiece();
+            }
+        }
+        return 0;
+    }
+
+    // Function to get the row the current piece would land on, from the skyline; cached until the piece moves sideways or rotates
+    int ghostY()
+    {
+        if (!ghostValid)
+        {
+            const Tetromino& p = currentPiece;
+            ghostRow = p.pos.y + board.dropDistance(shape_info(p.shape, p.rotation), p.pos.x, p.pos.y);
+            ghostValid = true;
+        }
+        return ghostRow;
+    }
+
+    // Calculates the drop delay (speed) in ticks based on level and score
+    int dropDelay() const
+    {
+        // Set a base delay: higher levels start faster
+        int base_delay = 70 - (stats.level - 1) * 8;
+
+        // Increase drop speed based on score milestones, each reducing the delay by 4 ticks
+        int milestones = std::min(stats.score / 1000, 4);
+        int bonus_speed = milestones * 4;
+
+        // Pieces will never drop faster than every 20 ticks
+        const int MAX_DROP = 20;
+        return std::max(base_delay - bonus_speed, MAX_DROP);
+    }
+
+    // Function to lock the current piece, clear lines and spawn the next piece; returns EVENT_* flags
+    int lockPiece()
+    {
+        int events = EVENT_PIECE_LOCKED;
+        const ShapeInfo& info = shape_info(currentPiece.shape, currentPiece.rotation);
+        board.place(info, currentPiece.pos.x, currentPiece.pos.y, currentPiece.shape + 1);
+
+        // Only the rows the piece landed in can have become full
+        int lines = board.clearFullRows(currentPiece.pos.y + info.minY, currentPiece.pos.y + info.maxY);
+        if (lines > 0)
+        {
+            events |= EVENT_LINES_CLEARED;
+            stats.linesCleared += lines;
+            stats.score += lines * 100 * stats.level;
+            // Level up every 5 lines, up to MAX_LEVEL
+            stats.level = std::min(MAX_LEVEL, startLevel + stats.linesCleared / 5);
+        }
+
+        return events | spawn();
+    }
+
+    // Function to spawn a new random tetromino at the top of the board; returns EVENT_GAME_OVER if it does not fit
+    int spawn()
+    {
+        currentPiece = Tetromino(nextShape(), 0, SPAWN_COLUMN, SPAWN_Y);
+        ghostValid = false;
+        if (observer)
+        {
+            observer(observerContext, SESSION_SPAWN, currentPiece.shape);
+        }
+        if (!fits(currentPiece))
+        {
+            gameOver = true;
+            return EVENT_GAME_OVER;
+        }
+        return 0;
+    }
+
+    // Function to pick the next shape index
+    int nextShape()
+    {
+        return randomizer.next();
+    }
+};
+
+// The classic game
+typedef BasicGameSession<GRID_WIDTH, GRID_HEIGHT> GameSession;
+
+#endif
@@ -0,0 +1,292 @@
+// INPUT PIPELINE //
+// Key presses and releases arrive as timestamped events (the front end pushes
+// them from SplashKit's key callbacks) and wait in a fixed-size queue. The
+// game loop drains the queue in time order between simulation ticks, so a
+// press is applied at the tick it happened in rather than at the next frame's
+// poll. Held left/right keys repeat with delayed auto-shift (DAS) and then
+// auto-repeat (ARR), also on event time. A latency histogram measures how long
+// each press takes to reach the screen.
+
+#ifndef TETRIS_INPUT_H
+#define TETRIS_INPUT_H
+
+#include "cstdint"
+#include "game_session.h"
+
+// Keys the game reacts to
+enum InputKey
+{
+    INPUT_LEFT,
+    INPUT_RIGHT,
+    INPUT_ROTATE,
+    INPUT_SOFT_DROP,
+    INPUT_HARD_DROP,
+    INPUT_KEY_COUNT
+};
+
+// Struct for one key press or release
+struct InputEvent
+{
+    double time; // When it happened (seconds, same clock as the simulation)
+    uint8_t key; // InputKey
+    bool down; // True for a press, false for a release
+};
+
+const int INPUT_QUEUE_SIZE = 256; // Events that can wait between frames (a power of two)
+
+// Struct for the queue of events waiting to be applied; a fixed ring, so pushing never allocates
+struct InputQueue
+{
+    InputEvent events[INPUT_QUEUE_SIZE];
+    uint32_t head; // Next event to pop
+    uint32_t tail; // Next free slot
+    long long dropped; // Events lost because the queue was full
+
+    InputQueue() : head(0), tail(0), dropped(0) {}
+
+    bool empty() const
+    {
+        return head == tail;
+    }
+
+    // Function to add an event; drops it if the queue is full
+    void push(const InputEvent& e)
+    {
+        if (tail - head == INPUT_QUEUE_SIZE)
+        {
+            dropped++;
+            return;
+        }
+        events[tail++ % INPUT_QUEUE_SIZE] = e;
+    }
+
+    const InputEvent& front() const
+    {
+        return events[head % INPUT_QUEUE_SIZE];
+    }
+
+    void pop()
+    {
+        head++;
+    }
+};
+
+// Struct for the auto-shift timing
+struct AutoShiftSettings
+{
+    double dasSeconds; // Hold time before a held left/right starts repeating
+    double arrSeconds; // Time between repeats once it does (0 = jump straight to the wall)
+
+    AutoShiftSettings() : dasSeconds(0.167), arrSeconds(0.033) {}
+};
+
+const int LATENCY_BUCKETS = 1000; // 0.1 ms each, so up to 100 ms; slower samples go in the last bucket
+
+// Struct for a histogram of latencies
+struct LatencyHistogram
+{
+    long long counts[LATENCY_BUCKETS];
+    long long total; // Samples recorded
+
+    LatencyHistogram()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        for (int i = 0; i < LATENCY_BUCKETS; i++)
+        {
+            counts[i] = 0;
+        }
+        total = 0;
+    }
+
+    // Function to record one latency in seconds
+    void add(double seconds)
+    {
+        int bucket = static_cast<int>(seconds * 10000.0);
+        bucket = bucket < 0 ? 0 : (bucket >= LATENCY_BUCKETS ? LATENCY_BUCKETS - 1 : bucket);
+        counts[bucket]++;
+        total++;
+    }
+
+    // Function to get the latency below which `p` percent of samples fall, in milliseconds (upper bucket edge)
+    double percentileMs(double p) const
+    {
+        if (total == 0)
+        {
+            return 0;
+        }
+        long long target = static_cast<long long>(total * p / 100.0);
+        long long seen = 0;
+        for (int i = 0; i < LATENCY_BUCKETS; i++)
+        {
+            seen += counts[i];
+            if (seen > target || seen == total)
+            {
+                return (i + 1) * 0.1;
+            }
+        }
+        return LATENCY_BUCKETS * 0.1;
+    }
+};
+
+const int INPUT_MAX_PENDING = 64; // Applied presses waiting to be shown, for latency measurement
+
+// Struct that turns queued key events into actions on a game session
+struct InputProcessor
+{
+    InputQueue queue;
+    AutoShiftSettings settings;
+    bool held[INPUT_KEY_COUNT]; // Keys currently down
+    int shiftDirection; // -1 or 1 while left or right is held, else 0
+    double nextShift; // Event time of the next auto-shift step
+    LatencyHistogram latency; // Press-to-screen latency of applied presses
+    double pending[INPUT_MAX_PENDING]; // Times of presses applied since the last shown frame
+    int pendingCount;
+
+    InputProcessor() : shiftDirection(0), nextShift(0), pendingCount(0)
+    {
+        releaseAll();
+    }
+
+    // Function to record a key event (called from the key callbacks)
+    void push(InputKey key, bool down, double time)
+    {
+        InputEvent e;
+        e.time = time;
+        e.key = static_cast<uint8_t>(key);
+        e.down = down;
+        queue.push(e);
+    }
+
+    // Function to tell whether soft drop is held
+    bool softDropHeld() const
+    {
+        return held[INPUT_SOFT_DROP];
+    }
+
+    // Function to apply every queued event and auto-shift step up to `until`, in time order; returns EVENT_* flags.
+    // With `enabled` false the events only update which keys are held (autoplay, pause).
+    int applyUntil(GameSession& session, double until, bool enabled)
+    {
+        int events = 0;
+        while (true)
+        {
+            bool haveEvent = !queue.empty() && queue.front().time <= until;
+            bool haveShift = shiftDirection != 0 && nextShift <= until;
+            if (!haveEvent && !haveShift)
+            {
+                break;
+            }
+
+            // An auto-shift step that is due before the next event goes first
+            if (haveShift && (!haveEvent || nextShift < queue.front().time))
+            {
+                if (enabled)
+                {
+                    shift(session);
+                }
+                nextShift += settings.arrSeconds > 0 ? settings.arrSeconds : 1.0 / 60.0;
+                continue;
+            }
+
+            InputEvent e = queue.front();
+            queue.pop();
+            events |= handle(session, e, enabled);
+        }
+        return events;
+    }
+
+    // Function to forget held keys and anything still queued (new game, pause)
+    void releaseAll()
+    {
+        queue.head = queue.tail;
+        for (int i = 0; i < INPUT_KEY_COUNT; i++)
+        {
+            held[i] = false;
+        }
+        shiftDirection = 0;
+        pendingCount = 0;
+    }
+
+    // Function to call once a frame has been presented; records the latency of the presses it showed
+    void frameShown(double now)
+    {
+        for (int i = 0; i < pendingCount; i++)
+        {
+            latency.add(now - pending[i]);
+        }
+        pendingCount = 0;
+    }
+
+private:
+    // Function to move one step in the held direction, or all the way with an ARR of 0
+    void shift(GameSession& session)
+    {
+        GameAction action = shiftDirection < 0 ? ACTION_MOVE_LEFT : ACTION_MOVE_RIGHT;
+        int steps = settings.arrSeconds > 0 ? 1 : GRID_WIDTH;
+        for (int i = 0; i < steps; i++)
+        {
+            int x = session.currentPiece.pos.x;
+            session.apply(action);
+            if (session.currentPiece.pos.x == x)
+            {
+                break; // Against a wall or a stack
+            }
+        }
+    }
+
+    // Function to apply one key event; returns EVENT_* flags
+    int handle(GameSession& session, const InputEvent& e, bool enabled)
+    {
+        if (e.down == held[e.key])
+        {
+            return 0; // Key repeat from the OS, or a release we never saw the press of
+        }
+        held[e.key] = e.down;
+
+        // Left and right: the most recent press wins, and releasing it falls back to the other if that is still held
+        if (e.key == INPUT_LEFT || e.key == INPUT_RIGHT)
+        {
+            int direction = e.key == INPUT_LEFT ? -1 : 1;
+            if (e.down)
+            {
+                shiftDirection = direction;
+            }
+            else if (shiftDirection == direction)
+            {
+                int other = e.key == INPUT_LEFT ? INPUT_RIGHT : INPUT_LEFT;
+                shiftDirection = held[other] ? -direction : 0;
+            }
+            nextShift = e.time + settings.dasSeconds;
+            if (!e.down || !enabled)
+            {
+                return 0;
+            }
+        }
+        else if (!e.down || !enabled || e.key == INPUT_SOFT_DROP)
+        {
+            return 0; // Soft drop is read as a held key by the gravity tick
+        }
+
+        if (pendingCount < INPUT_MAX_PENDING)
+        {
+            pending[pendingCount++] = e.time;
+        }
+        switch (e.key)
+        {
+            case INPUT_LEFT:
+                return session.apply(ACTION_MOVE_LEFT);
+            case INPUT_RIGHT:
+                return session.apply(ACTION_MOVE_RIGHT);
+            case INPUT_ROTATE:
+                return session.apply(ACTION_ROTATE);
+            default:
+                return session.apply(ACTION_HARD_DROP);
+        }
+    }
+};
+
+#endif
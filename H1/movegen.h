@@ -0,0 +1,217 @@
+// PLACEMENT GENERATOR //
+// Finds every distinct position where a piece can lock, following the same
+// moves the game allows: left, right, rotate (clockwise, no wall kicks) and
+// down. It assumes any number of moves can happen before gravity pulls the
+// piece down a row, so tucks and spins under overhangs count as reachable.
+// Two placements that cover the same cells (O rotations, I rows 0 and 2, ...)
+// are reported once. All buffers are fixed size, so generation never
+// allocates.
+
+#ifndef TETRIS_MOVEGEN_H
+#define TETRIS_MOVEGEN_H
+
+#include "cstdint"
+#include "cstring"
+#include "game_session.h"
+
+const int MOVEGEN_X_OFFSET = 3; // A piece's 4x4 grid can start up to 3 columns left of the board
+const int MOVEGEN_COLUMNS = GRID_WIDTH + MOVEGEN_X_OFFSET;
+const int MOVEGEN_STATES = 4 * MOVEGEN_COLUMNS * GRID_HEIGHT; // Every (rotation, x, y) a piece can be in
+const int MAX_PATH = MOVEGEN_STATES; // Longest possible action path to a placement
+
+// Struct for one place a piece can lock
+struct Placement
+{
+    int8_t rotation;
+    int8_t x, y; // Top-left of the 4x4 grid, as in Tetromino::pos
+    uint16_t state; // Search state it was found at, used to rebuild the path
+};
+
+// Struct for the placements of one piece
+struct PlacementList
+{
+    int count;
+    Placement items[MOVEGEN_STATES];
+};
+
+// Struct holding the search buffers; reuse one per thread
+struct MoveGenerator
+{
+    uint8_t visited[MOVEGEN_STATES];
+    uint16_t parent[MOVEGEN_STATES]; // State each state was first reached from
+    uint8_t parentAction[MOVEGEN_STATES]; // GameAction that reached it
+    uint16_t queue[MOVEGEN_STATES];
+    uint64_t keys[MOVEGEN_STATES]; // Cell keys of placements found so far, for removing duplicates
+    uint16_t startState;
+
+    static int stateIndex(int rotation, int x, int y)
+    {
+        return (rotation * MOVEGEN_COLUMNS + x + MOVEGEN_X_OFFSET) * GRID_HEIGHT + y;
+    }
+
+    static void stateCoords(int state, int& rotation, int& x, int& y)
+    {
+        y = state % GRID_HEIGHT;
+        x = (state / GRID_HEIGHT) % MOVEGEN_COLUMNS - MOVEGEN_X_OFFSET;
+        rotation = state / (GRID_HEIGHT * MOVEGEN_COLUMNS);
+    }
+
+    // Function to build a key that is equal for two placements exactly when they cover the same cells
+    static uint64_t cellKey(int shape, int rotation, int x, int y)
+    {
+        const ShapeInfo& info = shape_info(shape, rotation);
+        uint64_t key = static_cast<uint64_t>(y + info.minY) << 24 | static_cast<uint64_t>(x + info.minX) << 16;
+        for (int r = info.minY; r <= info.maxY; r++)
+        {
+            key |= static_cast<uint64_t>(info.rowMasks[r]) << (4 * (r - info.minY));
+        }
+        return key;
+    }
+
+    // Function to list every distinct lock position of `piece` on `board`; returns the number found
+    int generate(const Board& board, const Tetromino& piece, PlacementList& out)
+    {
+        out.count = 0;
+        memset(visited, 0, sizeof(visited));
+        if (board.collides(shape_info(piece.shape, piece.rotation), piece.pos.x, piece.pos.y))
+        {
+            return 0;
+        }
+
+        int head = 0;
+        int tail = 0;
+        startState = static_cast<uint16_t>(stateIndex(piece.rotation, piece.pos.x, piece.pos.y));
+        visited[startState] = 1;
+        queue[tail++] = startState;
+
+        // Breadth-first search, so each path is as short as possible
+        while (head < tail)
+        {
+            int state = queue[head++];
+            int rotation, x, y;
+            stateCoords(state, rotation, x, y);
+
+            const int moves[4][4] =
+            {
+                { ACTION_MOVE_LEFT, rotation, x - 1, y },
+                { ACTION_MOVE_RIGHT, rotation, x + 1, y },
+                { ACTION_ROTATE, (rotation + 1) % 4, x, y },
+                { ACTION_SOFT_DROP, rotation, x, y + 1 }
+            };
+
+            for (int m = 0; m < 4; m++)
+            {
+                int nr = moves[m][1];
+                int nx = moves[m][2];
+                int ny = moves[m][3];
+                if (board.collides(shape_info(piece.shape, nr), nx, ny))
+                {
+                    // Blocked from moving down: this state is a lock position
+                    if (m == 3)
+                    {
+                        addPlacement(out, piece.shape, state, rotation, x, y);
+                    }
+                    continue;
+                }
+
+                int next = stateIndex(nr, nx, ny);
+                if (!visited[next])
+                {
+                    visited[next] = 1;
+                    parent[next] = static_cast<uint16_t>(state);
+                    parentAction[next] = static_cast<uint8_t>(moves[m][0]);
+                    queue[tail++] = static_cast<uint16_t>(next);
+                }
+            }
+        }
+        return out.count;
+    }
+
+    // Function to write the actions that steer the piece from its start to `placement` (from the last generate call); returns the count
+    int path(const Placement& placement, GameAction* actions) const
+    {
+        int count = 0;
+        for (int state = placement.state; state != startState; state = parent[state])
+        {
+            actions[count++] = static_cast<GameAction>(parentAction[state]);
+        }
+
+        // Walked backwards from the placement, so reverse into start-to-finish order
+        for (int i = 0; i < count / 2; i++)
+        {
+            GameAction t = actions[i];
+            actions[i] = actions[count - 1 - i];
+            actions[count - 1 - i] = t;
+        }
+        return count;
+    }
+
+private:
+    void addPlacement(PlacementList& out, int shape, int state, int rotation, int x, int y)
+    {
+        uint64_t key = cellKey(shape, rotation, x, y);
+        for (int i = 0; i < out.count; i++)
+        {
+            if (keys[i] == key)
+            {
+                return;
+            }
+        }
+
+        keys[out.count] = key;
+        Placement& p = out.items[out.count++];
+        p.rotation = static_cast<int8_t>(rotation);
+        p.x = static_cast<int8_t>(x);
+        p.y = static_cast<int8_t>(y);
+        p.state = static_cast<uint16_t>(state);
+    }
+};
+
+// PERFT
+// Counts leaf placements to a given depth over a fixed piece sequence, like
+// perft in chess engines. The counts are a correctness oracle for the move
+// generator and the board, and the run time gives a throughput number.
+
+const int PERFT_MAX_DEPTH = 8;
+
+// Struct holding one thread's perft buffers
+struct Perft
+{
+    MoveGenerator gen;
+    PlacementList lists[PERFT_MAX_DEPTH];
+
+    // Function to count leaf placements of pieces[0..depth) starting from `board`
+    uint64_t count(const Board& board, const int* pieces, int depth)
+    {
+        return countFrom(board, pieces, depth, 0);
+    }
+
+    // Function to place one placement of `shape` on a copy of `board` and clear full rows
+    static Board apply(const Board& board, int shape, const Placement& p)
+    {
+        Board next = board;
+        next.place(shape_info(shape, p.rotation), p.x, p.y, shape + 1);
+        next.clearFullRows();
+        return next;
+    }
+
+private:
+    uint64_t countFrom(const Board& board, const int* pieces, int depth, int ply)
+    {
+        PlacementList& list = lists[ply];
+        int n = gen.generate(board, Tetromino(pieces[0], 0, SPAWN_X, SPAWN_Y), list);
+        if (depth == 1)
+        {
+            return static_cast<uint64_t>(n);
+        }
+
+        uint64_t total = 0;
+        for (int i = 0; i < n; i++)
+        {
+            total += countFrom(apply(board, pieces[0], list.items[i]), pieces + 1, depth - 1, ply + 1);
+        }
+        return total;
+    }
+};
+
+#endif
@@ -0,0 +1,193 @@
+// FRAME PROFILER //
+// Times the phases of each frame with scoped timers. Each phase keeps its last
+// PROFILE_WINDOW durations in a ring, from which the overlay reads p50, p99 and
+// max. While a trace is recording, every timed phase is also appended to a
+// buffer reserved up front, and stopTrace() writes it out as Chrome
+// trace_event JSON (open it in chrome://tracing or Perfetto). Recording a
+// sample is two clock reads and a few stores, and nothing allocates after
+// construction.
+
+#ifndef TETRIS_PROFILER_H
+#define TETRIS_PROFILER_H
+
+#include "algorithm"
+#include "chrono"
+#include "cstdint"
+#include "cstdio"
+#include "vector"
+
+// Phases of one frame of the game loop, in the order they run
+enum FramePhase
+{
+    PHASE_EVENTS, // process_events
+    PHASE_INPUT, // Mouse, pause and autoplay keys
+    PHASE_SIMULATE, // Fixed ticks with the key events between them
+    PHASE_AUDIO, // music_fade
+    PHASE_DRAW, // draw_game
+    PHASE_BUTTONS, // draw_buttons
+    PHASE_PRESENT, // refresh_screen
+    PHASE_FRAME, // The whole frame
+    PHASE_COUNT
+};
+
+const char* const PHASE_NAMES[PHASE_COUNT] = {"events", "input", "simulate", "audio", "draw", "buttons", "present", "frame"};
+
+const int PROFILE_WINDOW = 256; // Frames each phase's percentiles are taken over
+
+// Function to read the profiler clock in microseconds
+inline int64_t profiler_now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Struct for one timed phase in a trace
+struct TraceEvent
+{
+    int64_t startUs;
+    int32_t durationUs;
+    int32_t phase;
+};
+
+// Struct for percentiles of one phase over the window
+struct PhaseStats
+{
+    float p50Us;
+    float p99Us;
+    float maxUs;
+};
+
+// Struct for the profiler
+struct FrameProfiler
+{
+    // Creates a profiler that can record up to `traceCapacity` phases per trace
+    explicit FrameProfiler(size_t traceCapacity = 1 << 18) : count(0), next(0), recording(false), traceDropped(0), frameStart(0)
+    {
+        for (int p = 0; p < PHASE_COUNT; p++)
+        {
+            for (int i = 0; i < PROFILE_WINDOW; i++)
+            {
+                samples[p][i] = 0;
+            }
+        }
+        trace.reserve(traceCapacity);
+    }
+
+    // Function to mark the start of a frame; phases that do not run this frame count as zero
+    void beginFrame()
+    {
+        for (int p = 0; p < PHASE_COUNT; p++)
+        {
+            samples[p][next] = 0;
+        }
+        frameStart = profiler_now_us();
+    }
+
+    // Function to mark the end of a frame and move the window on
+    void endFrame()
+    {
+        record(PHASE_FRAME, frameStart, profiler_now_us());
+        next = (next + 1) % PROFILE_WINDOW;
+        count = std::min(count + 1, PROFILE_WINDOW);
+    }
+
+    // Function to record one phase's duration for the current frame
+    void record(FramePhase phase, int64_t startUs, int64_t endUs)
+    {
+        samples[phase][next] = static_cast<float>(endUs - startUs);
+        if (recording)
+        {
+            if (trace.size() < trace.capacity())
+            {
+                TraceEvent e = {startUs, static_cast<int32_t>(endUs - startUs), phase};
+                trace.push_back(e);
+            }
+            else
+            {
+                traceDropped++;
+            }
+        }
+    }
+
+    // Function to work out a phase's percentiles over the window
+    PhaseStats stats(FramePhase phase)
+    {
+        PhaseStats s = {0, 0, 0};
+        if (count == 0)
+        {
+            return s;
+        }
+        std::copy(samples[phase], samples[phase] + count, scratch);
+        int p50 = count / 2;
+        int p99 = std::min(count - 1, count * 99 / 100);
+        std::nth_element(scratch, scratch + p50, scratch + count);
+        s.p50Us = scratch[p50];
+        std::nth_element(scratch, scratch + p99, scratch + count);
+        s.p99Us = scratch[p99];
+        s.maxUs = *std::max_element(scratch, scratch + count);
+        return s;
+    }
+
+    bool tracing() const
+    {
+        return recording;
+    }
+
+    // Function to start recording a new trace
+    void startTrace()
+    {
+        trace.clear();
+        traceDropped = 0;
+        recording = true;
+    }
+
+    // Function to stop recording and write the trace as Chrome trace_event JSON; returns false if the file could not be written
+    bool stopTrace(const char* path)
+    {
+        recording = false;
+        FILE* f = fopen(path, "w");
+        if (!f)
+        {
+            return false;
+        }
+        fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        for (size_t i = 0; i < trace.size(); i++)
+        {
+            const TraceEvent& e = trace[i];
+            // The frame span goes on its own row so the phases nest under it
+            fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%d,\"pid\":1,\"tid\":%d}\n", i ? "," : "",
+                    PHASE_NAMES[e.phase], static_cast<long long>(e.startUs), e.durationUs, e.phase == PHASE_FRAME ? 1 : 2);
+        }
+        fprintf(f, "],\"otherData\":{\"droppedEvents\":%lld}}\n", traceDropped);
+        return fclose(f) == 0;
+    }
+
+private:
+    float samples[PHASE_COUNT][PROFILE_WINDOW]; // Durations in microseconds, a ring per phase
+    float scratch[PROFILE_WINDOW]; // Work space for percentiles
+    int count; // Frames in the window so far
+    int next; // Ring slot of the current frame
+    bool recording;
+    std::vector<TraceEvent> trace; // Reserved once, never grown past its capacity
+    long long traceDropped; // Phases left out because the trace buffer was full
+    int64_t frameStart;
+};
+
+// Struct for timing one phase: starts on construction, records on destruction
+struct ScopedPhase
+{
+    FrameProfiler& profiler;
+    FramePhase phase;
+    int64_t start;
+
+    ScopedPhase(FrameProfiler& profiler, FramePhase phase) : profiler(profiler), phase(phase), start(profiler_now_us()) {}
+
+    ~ScopedPhase()
+    {
+        profiler.record(phase, start, profiler_now_us());
+    }
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+};
+
+#endif
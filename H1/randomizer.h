@@ -0,0 +1,146 @@
+// PIECE RANDOMIZER //
+// Picks the sequence of shapes for a session. Piece N is a pure function of
+// the seed and N (a SplitMix64 counter: mix the seed's key plus N times the
+// golden gamma), so there is no shared state, any number of sessions can draw
+// pieces at once, and jumping to piece N costs the same as drawing the next
+// one. Two rules are supported: uniform (each piece independent) and 7-bag
+// (every run of 7 pieces is a shuffle of all 7 shapes, one shuffle per
+// counter value). generate() fills a buffer with a whole stretch of the
+// sequence at once for lookahead or batch work.
+
+#ifndef TETRIS_RANDOMIZER_H
+#define TETRIS_RANDOMIZER_H
+
+#include "cstdint"
+#include "zobrist.h"
+
+const int SHAPE_COUNT = 7;
+const uint64_t RANDOM_GAMMA = 0x9E3779B97F4A7C15ull; // SplitMix64's increment (2^64 / golden ratio)
+
+// Rules for picking pieces
+enum RandomizerKind
+{
+    RANDOMIZER_UNIFORM, // Each piece is any of the 7 shapes with equal chance
+    RANDOMIZER_BAG // Each group of 7 pieces is all 7 shapes in a random order
+};
+
+// Function to get the random value number `counter` of the stream with key `key`
+inline uint64_t random_at(uint64_t key, uint64_t counter)
+{
+    return mix64(key + (counter + 1) * RANDOM_GAMMA);
+}
+
+// Function to write the shuffle of the 7 shapes for one bag.
+// One random value in [0, 7!) is read as a Lehmer code, which is the same as a Fisher-Yates shuffle.
+inline void random_bag(uint64_t key, uint64_t bagIndex, uint8_t* out)
+{
+    uint64_t code = random_at(key, bagIndex) % 5040; // 7! = 5040; the modulo bias is below 2^-51
+    for (int i = 0; i < SHAPE_COUNT; i++)
+    {
+        out[i] = static_cast<uint8_t>(i);
+    }
+    for (int i = SHAPE_COUNT - 1; i > 0; i--)
+    {
+        int j = static_cast<int>(code % static_cast<uint64_t>(i + 1));
+        code /= static_cast<uint64_t>(i + 1);
+        uint8_t t = out[i];
+        out[i] = out[j];
+        out[j] = t;
+    }
+}
+
+// Struct for a session's piece sequence: the seed, the rule and how many pieces have been drawn
+struct PieceRandomizer
+{
+    uint64_t key; // Stream key derived from the seed
+    uint32_t seed;
+    uint8_t kind; // RandomizerKind
+    uint64_t index; // Number of the next piece
+    uint64_t bagIndex; // Bag held in `bag`, or ~0 if none
+    uint8_t bag[SHAPE_COUNT];
+
+    PieceRandomizer() : key(0), seed(0), kind(RANDOMIZER_UNIFORM), index(0), bagIndex(~0ull)
+    {
+        reset(1, RANDOMIZER_UNIFORM);
+    }
+
+    // Function to start the sequence for a seed from piece 0
+    void reset(uint32_t newSeed, RandomizerKind newKind)
+    {
+        seed = newSeed;
+        kind = static_cast<uint8_t>(newKind);
+        key = mix64(newSeed);
+        index = 0;
+        bagIndex = ~0ull;
+    }
+
+    // Function to get piece number `n` without moving the sequence
+    int pieceAt(uint64_t n) const
+    {
+        if (kind == RANDOMIZER_BAG)
+        {
+            uint8_t shuffled[SHAPE_COUNT];
+            random_bag(key, n / SHAPE_COUNT, shuffled);
+            return shuffled[n % SHAPE_COUNT];
+        }
+        return static_cast<int>(random_at(key, n) % SHAPE_COUNT); // Modulo bias below 2^-61
+    }
+
+    // Function to draw the next piece
+    int next()
+    {
+        uint64_t n = index++;
+        if (kind != RANDOMIZER_BAG)
+        {
+            return static_cast<int>(random_at(key, n) % SHAPE_COUNT);
+        }
+        if (n / SHAPE_COUNT != bagIndex)
+        {
+            bagIndex = n / SHAPE_COUNT;
+            random_bag(key, bagIndex, bag);
+        }
+        return bag[n % SHAPE_COUNT];
+    }
+
+    // Function to make piece `n` the next one drawn
+    void jump(uint64_t n)
+    {
+        index = n;
+    }
+
+    // Function to write pieces first .. first + count - 1 to `out` (does not move the sequence)
+    void generate(uint64_t first, int count, uint8_t* out) const
+    {
+        if (kind != RANDOMIZER_BAG)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                out[i] = static_cast<uint8_t>(random_at(key, first + i) % SHAPE_COUNT);
+            }
+            return;
+        }
+
+        // Whole bags are shuffled straight into the output; only a partial first or last bag goes through a copy
+        int i = 0;
+        while (i < count)
+        {
+            uint64_t n = first + i;
+            uint64_t b = n / SHAPE_COUNT;
+            int offset = static_cast<int>(n % SHAPE_COUNT);
+            if (offset == 0 && count - i >= SHAPE_COUNT)
+            {
+                random_bag(key, b, out + i);
+                i += SHAPE_COUNT;
+                continue;
+            }
+            uint8_t shuffled[SHAPE_COUNT];
+            random_bag(key, b, shuffled);
+            for (; offset < SHAPE_COUNT && i < count; offset++)
+            {
+                out[i++] = shuffled[offset];
+            }
+        }
+    }
+};
+
+#endif
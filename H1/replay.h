@@ -0,0 +1,728 @@
+// REPLAYS //
+// A replay is the game's seed, start level and randomizer followed by a byte stream of
+// everything that drove the session: each action, each change of the soft
+// drop key, and each spawned piece (to catch desyncs). Every record starts
+// with a varint holding (ticks since the previous record << 4 | kind), so an
+// action is usually one byte. A keyframe with the full board, piece, stats and
+// piece count goes in every REPLAY_KEYFRAME_TICKS ticks (by default), so playback can seek
+// anywhere by restoring the nearest keyframe and simulating forward. When the
+// game is rewound, the restored state is written in full the same way.
+//
+// ReplayRecorder fills fixed-size chunks on the game thread and hands full
+// ones to a writer thread, so disk writes never stall a frame. ReplayFile maps
+// a finished replay into memory and ReplayPlayer re-simulates it at full
+// speed. A replay cut short (crash, full buffers) plays back up to its last
+// complete record.
+
+#ifndef TETRIS_REPLAY_H
+#define TETRIS_REPLAY_H
+
+#include "algorithm"
+#include "atomic"
+#include "condition_variable"
+#include "cstdint"
+#include "cstdio"
+#include "cstring"
+#include "memory"
+#include "mutex"
+#include "thread"
+#include "vector"
+#include "game_session.h"
+
+#if defined(_WIN32)
+#include "fstream"
+#include "iterator"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const uint32_t REPLAY_MAGIC = 0x50525454; // "TTRP" when read as little-endian bytes
+const uint8_t REPLAY_VERSION = 3;
+const int REPLAY_HEADER_BYTES = 11; // magic, version, start level, randomizer kind, seed
+const int REPLAY_KEYFRAME_TICKS = 600; // Ticks between keyframes (10 seconds of play)
+
+// Kinds of record in the stream; actions use their GameAction value
+enum ReplayRecord
+{
+    REPLAY_SOFT_DROP_ON = 5,
+    REPLAY_SOFT_DROP_OFF = 6,
+    REPLAY_SPAWN = 7, // Followed by the shape
+    REPLAY_KEYFRAME = 8, // Followed by REPLAY_KEYFRAME_BYTES of state
+    REPLAY_END = 9, // The game ended; its tick is the final tick
+    REPLAY_RESTORE = 10 // Followed by REPLAY_KEYFRAME_BYTES: the game was put back into this state (rewind)
+};
+
+const int REPLAY_KEYFRAME_BYTES = GRID_HEIGHT * 2 + GRID_HEIGHT * GRID_WIDTH + 4 + 16 + 4 + 4 + 2;
+
+// Function to write a session's state as a keyframe payload
+inline void replay_pack_keyframe(const GameSession& s, bool softDrop, uint8_t* out)
+{
+    uint8_t* p = out;
+    for (int y = 0; y < GRID_HEIGHT; y++)
+    {
+        *p++ = static_cast<uint8_t>(s.board.rows[y]);
+        *p++ = static_cast<uint8_t>(s.board.rows[y] >> 8);
+    }
+    memcpy(p, s.board.colors, GRID_HEIGHT * GRID_WIDTH);
+    p += GRID_HEIGHT * GRID_WIDTH;
+    *p++ = static_cast<uint8_t>(s.currentPiece.shape);
+    *p++ = static_cast<uint8_t>(s.currentPiece.rotation);
+    *p++ = static_cast<uint8_t>(s.currentPiece.pos.x);
+    *p++ = static_cast<uint8_t>(s.currentPiece.pos.y);
+    int32_t words[4] = {s.stats.score, s.stats.level, s.stats.linesCleared, s.startLevel};
+    uint32_t more[2] = {static_cast<uint32_t>(s.dropTimer), static_cast<uint32_t>(s.randomizer.index)};
+    for (int i = 0; i < 4; i++)
+    {
+        for (int b = 0; b < 4; b++)
+        {
+            *p++ = static_cast<uint8_t>(static_cast<uint32_t>(words[i]) >> (8 * b));
+        }
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        for (int b = 0; b < 4; b++)
+        {
+            *p++ = static_cast<uint8_t>(more[i] >> (8 * b));
+        }
+    }
+    *p++ = s.gameOver ? 1 : 0;
+    *p++ = softDrop ? 1 : 0;
+}
+
+// Function to read a 32-bit little-endian word
+inline uint32_t replay_read32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Function to restore a session from a keyframe payload (the skyline, hash and ghost are rebuilt).
+// The session's randomizer must already hold the replay's seed and kind; the keyframe only says how far along it is.
+inline void replay_unpack_keyframe(const uint8_t* in, GameSession& s, bool& softDrop)
+{
+    const uint8_t* p = in;
+    s.board.clear();
+    for (int y = 0; y < GRID_HEIGHT; y++, p += 2)
+    {
+        s.board.rows[y] = static_cast<RowBits>(p[0] | (p[1] << 8));
+        s.board.hash ^= Board::rowHash(y, s.board.rows[y]);
+    }
+    memcpy(s.board.colors, p, GRID_HEIGHT * GRID_WIDTH);
+    p += GRID_HEIGHT * GRID_WIDTH;
+    s.board.recomputeHeights();
+    s.currentPiece = Tetromino(p[0], p[1], static_cast<int8_t>(p[2]), static_cast<int8_t>(p[3]));
+    p += 4;
+    s.stats.score = static_cast<int32_t>(replay_read32(p));
+    s.stats.level = static_cast<int32_t>(replay_read32(p + 4));
+    s.stats.linesCleared = static_cast<int32_t>(replay_read32(p + 8));
+    s.startLevel = static_cast<int32_t>(replay_read32(p + 12));
+    s.dropTimer = static_cast<int>(replay_read32(p + 16));
+    s.randomizer.jump(replay_read32(p + 20));
+    s.gameOver = p[24] != 0;
+    softDrop = p[25] != 0;
+    s.ghostValid = false;
+}
+
+const int REPLAY_CHUNK_BYTES = 64 * 1024; // Bytes handed to the writer thread at a time
+const int REPLAY_CHUNKS = 8; // Chunks that can be in flight; if all are, the rest of the game is not recorded
+const int REPLAY_QUEUE = 32; // Writer commands that can wait (chunk writes plus file closes)
+
+// Struct for recording a session to disk; begin() puts it in front of the session's observer, and end() takes it out again
+struct ReplayRecorder
+{
+    int keyframeTicks; // Ticks between keyframes; tools can lower it so short games get keyframes after the first
+
+    // With `waitForChunks` the recorder waits for the writer instead of truncating (tools that record faster than disk)
+    explicit ReplayRecorder(bool waitForChunks = false)
+        : keyframeTicks(REPLAY_KEYFRAME_TICKS), buffers(new uint8_t[REPLAY_CHUNKS * REPLAY_CHUNK_BYTES]), waitForChunks(waitForChunks), session(nullptr), file(nullptr), chunk(0), used(0),
+          next(nullptr), nextContext(nullptr), ticks(0), lastTick(0), softDrop(false), pendingKeyframe(false), truncated(false), queueHead(0), queueTail(0), stopping(false)
+    {
+        for (int i = 0; i < REPLAY_CHUNKS; i++)
+        {
+            busy[i].store(false, std::memory_order_relaxed);
+        }
+        writer = std::thread([this] { writerLoop(); });
+    }
+
+    ~ReplayRecorder()
+    {
+        end();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        writer.join();
+    }
+
+    ReplayRecorder(const ReplayRecorder&) = delete;
+    ReplayRecorder& operator=(const ReplayRecorder&) = delete;
+
+    // Function to start recording a session that was just reset with this seed and level; returns false if the file cannot be opened
+    bool begin(const char* path, GameSession& s, uint32_t seed, int level)
+    {
+        end();
+        file = fopen(path, "wb");
+        if (!file)
+        {
+            return false;
+        }
+        setvbuf(file, nullptr, _IONBF, 0); // Chunks are written whole, so stdio buffering would only add a copy (and an allocation)
+        session = &s;
+        ticks = 0;
+        lastTick = 0;
+        softDrop = false;
+        pendingKeyframe = false;
+        truncated = false;
+        if (!takeChunk())
+        {
+            truncated = true;
+        }
+
+        uint8_t header[REPLAY_HEADER_BYTES];
+        for (int b = 0; b < 4; b++)
+        {
+            header[b] = static_cast<uint8_t>(REPLAY_MAGIC >> (8 * b));
+            header[7 + b] = static_cast<uint8_t>(seed >> (8 * b));
+        }
+        header[4] = REPLAY_VERSION;
+        header[5] = static_cast<uint8_t>(level);
+        header[6] = s.randomizer.kind;
+        putBytes(header, REPLAY_HEADER_BYTES);
+        keyframe();
+
+        next = s.observer;
+        nextContext = s.observerContext;
+        s.observer = observe;
+        s.observerContext = this;
+        return true;
+    }
+
+    // Function to finish the current recording (if any) and let the writer close its file
+    void end()
+    {
+        if (!file)
+        {
+            return;
+        }
+        session->observer = next;
+        session->observerContext = nextContext;
+        putRecord(REPLAY_END);
+        submit();
+        push(Command{file, -1, 0});
+        file = nullptr;
+        session = nullptr;
+    }
+
+    bool recording() const
+    {
+        return file != nullptr;
+    }
+
+private:
+    // Struct for a job for the writer thread: write a chunk to a file, or close the file (chunk -1)
+    struct Command
+    {
+        FILE* file;
+        int chunk;
+        int length;
+    };
+
+    std::unique_ptr<uint8_t[]> buffers; // REPLAY_CHUNKS chunks, back to back
+    std::atomic<bool> busy[REPLAY_CHUNKS]; // Chunks the writer has not finished with
+    bool waitForChunks;
+    GameSession* session;
+    FILE* file; // Current recording's file, or nullptr when not recording
+    int chunk; // Chunk being filled, or -1 once recording ran out of chunks
+    int used; // Bytes used in that chunk
+    SessionObserver next; // The observer this one was put in front of
+    void* nextContext;
+    int ticks; // Ticks recorded so far
+    int lastTick; // Tick of the previous record
+    bool softDrop; // Soft drop state as of the last tick
+    bool pendingKeyframe; // A keyframe is due before the next action or tick
+    bool truncated; // True once bytes had to be dropped
+
+    Command queue[REPLAY_QUEUE]; // Ring of pending commands
+    int queueHead;
+    int queueTail;
+    bool stopping;
+    std::mutex lock;
+    std::condition_variable wake; // Signalled when a command is queued
+    std::condition_variable space; // Signalled when the writer takes one
+    std::thread writer;
+
+    // Function the session calls for every action, tick and spawn
+    static void observe(void* context, int input, int value)
+    {
+        ReplayRecorder* r = static_cast<ReplayRecorder*>(context);
+
+        // Actions and ticks are reported before they run, so the session is between inputs here.
+        // Spawns happen in the middle of one and restores after one, so a due keyframe waits for the next action or tick.
+        if (r->pendingKeyframe && (input == SESSION_ACTION || input == SESSION_TICK))
+        {
+            r->pendingKeyframe = false;
+            r->keyframe();
+        }
+
+        if (input == SESSION_ACTION)
+        {
+            r->putRecord(value);
+        }
+        else if (input == SESSION_SPAWN)
+        {
+            r->putRecord(REPLAY_SPAWN);
+            r->putByte(static_cast<uint8_t>(value));
+        }
+        else if (input == SESSION_RESTORE)
+        {
+            r->putRecord(REPLAY_RESTORE);
+            uint8_t payload[REPLAY_KEYFRAME_BYTES];
+            replay_pack_keyframe(*r->session, r->softDrop, payload);
+            r->putBytes(payload, REPLAY_KEYFRAME_BYTES);
+        }
+        else
+        {
+            // Soft drop is recorded only when it changes; the tick itself is implied by the next record's delta
+            if ((value != 0) != r->softDrop)
+            {
+                r->softDrop = value != 0;
+                r->putRecord(r->softDrop ? REPLAY_SOFT_DROP_ON : REPLAY_SOFT_DROP_OFF);
+            }
+            r->ticks++;
+            r->pendingKeyframe = r->ticks % r->keyframeTicks == 0;
+        }
+
+        if (r->next)
+        {
+            r->next(r->nextContext, input, value);
+        }
+    }
+
+    // Function to write a keyframe of the session as it is now, then flush so a crash loses at most the last few seconds
+    void keyframe()
+    {
+        putRecord(REPLAY_KEYFRAME);
+        uint8_t payload[REPLAY_KEYFRAME_BYTES];
+        replay_pack_keyframe(*session, softDrop, payload);
+        putBytes(payload, REPLAY_KEYFRAME_BYTES);
+        submit();
+        if (!truncated && !takeChunk())
+        {
+            truncated = true;
+        }
+    }
+
+    // Function to write one record header: varint of (ticks since the previous record << 4 | kind)
+    void putRecord(int kind)
+    {
+        uint64_t v = (static_cast<uint64_t>(ticks - lastTick) << 4) | static_cast<uint64_t>(kind);
+        lastTick = ticks;
+        while (v >= 0x80)
+        {
+            putByte(static_cast<uint8_t>(v | 0x80));
+            v >>= 7;
+        }
+        putByte(static_cast<uint8_t>(v));
+    }
+
+    void putBytes(const uint8_t* bytes, int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            putByte(bytes[i]);
+        }
+    }
+
+    void putByte(uint8_t b)
+    {
+        if (truncated)
+        {
+            return;
+        }
+        if (used == REPLAY_CHUNK_BYTES)
+        {
+            submit();
+            if (!takeChunk())
+            {
+                truncated = true;
+                return;
+            }
+        }
+        buffers[chunk * REPLAY_CHUNK_BYTES + used++] = b;
+    }
+
+    // Function to pick a free chunk to fill next; returns false if the writer still has all of them
+    bool takeChunk()
+    {
+        do
+        {
+            for (int i = 0; i < REPLAY_CHUNKS; i++)
+            {
+                if (!busy[i].load(std::memory_order_acquire))
+                {
+                    chunk = i;
+                    used = 0;
+                    return true;
+                }
+            }
+            if (waitForChunks)
+            {
+                std::this_thread::yield();
+            }
+        } while (waitForChunks);
+        chunk = -1;
+        return false;
+    }
+
+    // Function to hand the chunk being filled to the writer thread
+    void submit()
+    {
+        if (chunk < 0 || used == 0)
+        {
+            return;
+        }
+        busy[chunk].store(true, std::memory_order_relaxed);
+        push(Command{file, chunk, used});
+        chunk = -1;
+        used = 0;
+    }
+
+    // Function to queue a command; only waits if the writer is a whole queue behind (many games ended at once)
+    void push(const Command& c)
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            space.wait(guard, [this] { return (queueTail + 1) % REPLAY_QUEUE != queueHead; });
+            queue[queueTail] = c;
+            queueTail = (queueTail + 1) % REPLAY_QUEUE;
+        }
+        wake.notify_one();
+    }
+
+    // Function run by the writer thread: write chunks and close files in the order they were queued
+    void writerLoop()
+    {
+        while (true)
+        {
+            Command c;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [this] { return stopping || queueHead != queueTail; });
+                if (queueHead == queueTail)
+                {
+                    return;
+                }
+                c = queue[queueHead];
+                queueHead = (queueHead + 1) % REPLAY_QUEUE;
+            }
+            space.notify_one();
+            if (c.chunk < 0)
+            {
+                fclose(c.file);
+                continue;
+            }
+            fwrite(&buffers[c.chunk * REPLAY_CHUNK_BYTES], 1, c.length, c.file);
+            busy[c.chunk].store(false, std::memory_order_release);
+        }
+    }
+};
+
+// Struct for a replay file mapped into memory (read-only)
+struct ReplayFile
+{
+    const uint8_t* data;
+    size_t size;
+
+    ReplayFile() : data(nullptr), size(0) {}
+    ~ReplayFile()
+    {
+        close();
+    }
+
+    ReplayFile(const ReplayFile&) = delete;
+    ReplayFile& operator=(const ReplayFile&) = delete;
+
+    // Function to map a file; returns false if it cannot be read
+    bool open(const char* path)
+    {
+        close();
+#if defined(_WIN32)
+        // No mmap here, so read the file into memory instead
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            return false;
+        }
+        copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data = reinterpret_cast<const uint8_t*>(copy.data());
+        size = copy.size();
+        return true;
+#else
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+        {
+            return false;
+        }
+        madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+        data = static_cast<const uint8_t*>(p);
+        size = static_cast<size_t>(st.st_size);
+        return true;
+#endif
+    }
+
+    void close()
+    {
+#if !defined(_WIN32)
+        if (data)
+        {
+            munmap(const_cast<uint8_t*>(data), size);
+        }
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+private:
+#if defined(_WIN32)
+    std::vector<char> copy;
+#endif
+};
+
+// Struct for one keyframe found in a replay
+struct ReplayKeyframe
+{
+    int tick;
+    size_t offset; // Offset of its payload
+};
+
+// Struct for playing a replay back by re-simulating it
+struct ReplayPlayer
+{
+    GameSession session; // The game as of `tick`
+    int tick; // Ticks simulated so far
+    int endTick; // Final tick, or the last complete record's tick if the replay was cut short
+    bool finished; // True once every record has been played
+    bool desynced; // True if a spawn or keyframe did not match the re-simulated game
+    uint32_t seed;
+    int level;
+    RandomizerKind kind;
+    std::vector<ReplayKeyframe> keyframes;
+
+    ReplayPlayer() : tick(0), endTick(0), finished(true), desynced(false), seed(0), level(1), kind(RANDOMIZER_UNIFORM), data(nullptr), size(0), cursor(0), cursorTick(0), softDrop(false) {}
+
+    // Function to start playing a replay from its first tick; returns false if it is not a replay
+    bool open(const uint8_t* bytes, size_t length)
+    {
+        data = bytes;
+        size = length;
+        if (size < static_cast<size_t>(REPLAY_HEADER_BYTES) || replay_read32(data) != REPLAY_MAGIC || data[4] != REPLAY_VERSION)
+        {
+            return false;
+        }
+        level = data[5];
+        kind = static_cast<RandomizerKind>(data[6]);
+        seed = replay_read32(data + 7);
+
+        // One pass over the records finds every keyframe and the last tick
+        keyframes.clear();
+        size_t at = REPLAY_HEADER_BYTES;
+        int t = 0;
+        int kind;
+        while (readRecord(at, t, kind))
+        {
+            if (kind == REPLAY_KEYFRAME || kind == REPLAY_RESTORE)
+            {
+                keyframes.push_back(ReplayKeyframe{t, at});
+            }
+            if (!skipPayload(at, kind))
+            {
+                break;
+            }
+        }
+        endTick = t;
+        return restart();
+    }
+
+    // Function to go back to the start of the game
+    bool restart()
+    {
+        session.randomizer.kind = static_cast<uint8_t>(kind);
+        session.reset(level, seed);
+        tick = 0;
+        cursor = REPLAY_HEADER_BYTES;
+        cursorTick = 0;
+        softDrop = false;
+        finished = false;
+        desynced = false;
+        return true;
+    }
+
+    // Function to simulate up to `target` ticks (or the end of the replay); returns false once the replay is finished
+    bool runTo(int target)
+    {
+        while (!finished)
+        {
+            size_t at = cursor;
+            int t = cursorTick;
+            int kind;
+            if (!readRecord(at, t, kind))
+            {
+                // No records left: only ticks until the end
+                advanceTo(std::min(target, endTick));
+                finished = tick >= endTick;
+                return !finished;
+            }
+            if (t > target)
+            {
+                advanceTo(target);
+                return true;
+            }
+            advanceTo(t);
+            cursor = at;
+            cursorTick = t;
+            playRecord(kind);
+        }
+        return false;
+    }
+
+    // Function to jump to a tick: restores the last keyframe (or rewind) at or before it, then simulates the rest
+    void seek(int target)
+    {
+        const ReplayKeyframe* best = nullptr;
+        for (const ReplayKeyframe& k : keyframes)
+        {
+            if (k.tick <= target)
+            {
+                best = &k;
+            }
+        }
+        if (target >= tick && (!best || best->tick <= tick))
+        {
+            // Playing on from here is no slower than restoring a keyframe
+            runTo(target);
+            return;
+        }
+        if (!best)
+        {
+            restart();
+            runTo(target);
+            return;
+        }
+        replay_unpack_keyframe(data + best->offset, session, softDrop);
+        tick = best->tick;
+        cursor = best->offset + REPLAY_KEYFRAME_BYTES;
+        cursorTick = best->tick;
+        finished = false;
+        runTo(target);
+    }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t cursor; // Offset of the next record
+    int cursorTick; // Tick of the record before it, which the next one's delta counts from
+    bool softDrop;
+
+    // Function to read one record header at `at`; adds its delta to `t`; returns false at the end or a cut-off record
+    bool readRecord(size_t& at, int& t, int& kind) const
+    {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (at >= size)
+            {
+                return false;
+            }
+            uint8_t b = data[at++];
+            v |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80))
+            {
+                kind = static_cast<int>(v & 15);
+                t += static_cast<int>(v >> 4);
+                // A record whose payload was cut off counts as missing
+                size_t payload = kind == REPLAY_SPAWN ? 1 : (kind == REPLAY_KEYFRAME || kind == REPLAY_RESTORE ? REPLAY_KEYFRAME_BYTES : 0);
+                return at + payload <= size && kind != REPLAY_END;
+            }
+        }
+        return false;
+    }
+
+    // Function to step past a record's payload; returns false for a kind that is not understood
+    bool skipPayload(size_t& at, int kind) const
+    {
+        if (kind == REPLAY_SPAWN)
+        {
+            at += 1;
+        }
+        else if (kind == REPLAY_KEYFRAME || kind == REPLAY_RESTORE)
+        {
+            at += REPLAY_KEYFRAME_BYTES;
+        }
+        else if (kind > REPLAY_RESTORE)
+        {
+            return false;
+        }
+        return true;
+    }
+
+    void advanceTo(int target)
+    {
+        while (tick < target)
+        {
+            session.tick(softDrop);
+            tick++;
+        }
+    }
+
+    // Function to apply the record just read (the cursor is on its payload)
+    void playRecord(int kind)
+    {
+        if (kind <= ACTION_HARD_DROP)
+        {
+            session.apply(static_cast<GameAction>(kind));
+        }
+        else if (kind == REPLAY_SOFT_DROP_ON || kind == REPLAY_SOFT_DROP_OFF)
+        {
+            softDrop = kind == REPLAY_SOFT_DROP_ON;
+        }
+        else if (kind == REPLAY_SPAWN)
+        {
+            desynced = desynced || data[cursor] != session.currentPiece.shape;
+        }
+        else if (kind == REPLAY_KEYFRAME)
+        {
+            desynced = desynced || memcmp(data + cursor, keyframeBytes(), REPLAY_KEYFRAME_BYTES) != 0;
+        }
+        else if (kind == REPLAY_RESTORE)
+        {
+            replay_unpack_keyframe(data + cursor, session, softDrop);
+        }
+        skipPayload(cursor, kind);
+    }
+
+    // Function to pack the current state the same way the recorder does, for comparing with a keyframe
+    const uint8_t* keyframeBytes()
+    {
+        replay_pack_keyframe(session, softDrop, packed);
+        return packed;
+    }
+
+    uint8_t packed[REPLAY_KEYFRAME_BYTES];
+};
+
+#endif
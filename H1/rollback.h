@@ -0,0 +1,222 @@
+// ROLLBACK //
+// Keeps the last ROLLBACK_TICKS ticks of a session in a ring: a snapshot of
+// the state at the start of each tick and the actions applied during it.
+// rewind() puts an earlier tick back at once (undo), and resimulate() re-runs
+// the kept inputs from an earlier tick to the present, for example after
+// inputsAt() has corrected what happened in that tick. The buffer watches the
+// session through its observer, so nothing else has to report inputs to it,
+// and saving a tick is one snapshot copy with no allocation.
+
+#ifndef TETRIS_ROLLBACK_H
+#define TETRIS_ROLLBACK_H
+
+#include "algorithm"
+#include "cstdint"
+#include "game_session.h"
+
+const int ROLLBACK_TICKS = 600; // Ticks kept (10 seconds of play)
+const int ROLLBACK_MAX_ACTIONS = 14; // Actions kept per tick; a tick with more cannot be re-simulated
+
+// Struct for what drove one tick
+struct TickInputs
+{
+    uint8_t softDrop; // Whether soft drop was held for the tick
+    uint8_t overflow; // True if the tick had more than ROLLBACK_MAX_ACTIONS actions
+    uint8_t actionCount;
+    uint8_t actions[ROLLBACK_MAX_ACTIONS]; // GameAction values, in the order they were applied
+};
+
+// Struct for one kept tick
+struct TickHistory
+{
+    GameSnapshot state; // The session before the tick's actions
+    TickInputs inputs;
+};
+
+// Struct for the rollback ring of a session
+struct RollbackBuffer
+{
+    RollbackBuffer() : session(nullptr), next(nullptr), nextContext(nullptr), first(0), current(0), pendingSave(false), busy(false) {}
+
+    RollbackBuffer(const RollbackBuffer&) = delete;
+    RollbackBuffer& operator=(const RollbackBuffer&) = delete;
+
+    // Function to start watching a session, in front of any observer it already has
+    void attach(GameSession& s)
+    {
+        session = &s;
+        next = s.observer;
+        nextContext = s.observerContext;
+        s.observer = observe;
+        s.observerContext = this;
+        clear();
+    }
+
+    // Function to forget the history and start it from the session as it is now (call after reset())
+    void clear()
+    {
+        first = 0;
+        current = 0;
+        save();
+    }
+
+    // Function to get the oldest tick that can still be restored
+    long long oldestTick()
+    {
+        flush();
+        return first;
+    }
+
+    // Function to get the tick the session is in now
+    long long currentTick()
+    {
+        flush();
+        return current;
+    }
+
+    // Function to go back `ticks` ticks, or as far as the history goes; returns how many ticks it went back
+    int rewind(int ticks)
+    {
+        flush();
+        long long target = std::max(first, current - ticks);
+        int back = static_cast<int>(current - target);
+        restoreTick(target);
+        return back;
+    }
+
+    // Function to get the inputs kept for a tick between oldestTick() and currentTick(), to correct them before resimulate()
+    TickInputs& inputsAt(long long tick)
+    {
+        return slot(tick).inputs;
+    }
+
+    // Function to restore `tick` and re-run every kept input from there back to the present (rollback).
+    // Returns false, changing nothing, if the tick is not kept or some tick since then had too many actions to keep.
+    bool resimulate(long long tick)
+    {
+        flush();
+        if (tick < first || tick > current)
+        {
+            return false;
+        }
+        int count = static_cast<int>(current - tick);
+        for (int i = 0; i <= count; i++)
+        {
+            if (slot(tick + i).inputs.overflow)
+            {
+                return false;
+            }
+        }
+
+        // Re-running the inputs records them again, so copy them out first.
+        // The last one is the present tick, which has had its actions but not its gravity yet.
+        for (int i = 0; i <= count; i++)
+        {
+            scratch[i] = slot(tick + i).inputs;
+        }
+        restoreTick(tick);
+        for (int i = 0; i <= count; i++)
+        {
+            for (int a = 0; a < scratch[i].actionCount; a++)
+            {
+                session->apply(static_cast<GameAction>(scratch[i].actions[a]));
+            }
+            if (i < count)
+            {
+                session->tick(scratch[i].softDrop != 0);
+            }
+        }
+        return true;
+    }
+
+private:
+    TickHistory ring[ROLLBACK_TICKS];
+    TickInputs scratch[ROLLBACK_TICKS + 1]; // Inputs being re-run by resimulate()
+    GameSession* session;
+    SessionObserver next; // The observer this one was put in front of
+    void* nextContext;
+    long long first; // Oldest kept tick
+    long long current; // Tick the session is in (its snapshot is saved once pendingSave is clear)
+    bool pendingSave; // A tick just ran, so the next tick's snapshot is due before its first input
+    bool busy; // This buffer is restoring the session itself
+
+    TickHistory& slot(long long tick)
+    {
+        return ring[tick % ROLLBACK_TICKS];
+    }
+
+    // Function to save the session as the start of the current tick
+    void save()
+    {
+        TickHistory& h = slot(current);
+        session->save(h.state);
+        h.inputs.softDrop = 0;
+        h.inputs.overflow = 0;
+        h.inputs.actionCount = 0;
+        pendingSave = false;
+    }
+
+    // Function to save the current tick's snapshot if the last tick has run since it was due
+    void flush()
+    {
+        if (pendingSave)
+        {
+            save();
+        }
+    }
+
+    // Function to put the session back to a kept tick and drop the history after it
+    void restoreTick(long long tick)
+    {
+        busy = true;
+        session->restore(slot(tick).state);
+        busy = false;
+        current = tick;
+        save();
+    }
+
+    // Function the session calls for every action, tick, spawn and restore
+    static void observe(void* context, int input, int value)
+    {
+        RollbackBuffer* r = static_cast<RollbackBuffer*>(context);
+
+        // Actions and ticks are reported before they run, so the session is between inputs here
+        if (input == SESSION_ACTION || input == SESSION_TICK)
+        {
+            r->flush();
+        }
+
+        if (input == SESSION_ACTION)
+        {
+            TickInputs& in = r->slot(r->current).inputs;
+            if (in.actionCount < ROLLBACK_MAX_ACTIONS)
+            {
+                in.actions[in.actionCount++] = static_cast<uint8_t>(value);
+            }
+            else
+            {
+                in.overflow = 1;
+            }
+        }
+        else if (input == SESSION_TICK)
+        {
+            r->slot(r->current).inputs.softDrop = static_cast<uint8_t>(value);
+            r->current++;
+            r->first = std::max(r->first, r->current - ROLLBACK_TICKS + 1);
+            r->pendingSave = true;
+        }
+        else if (input == SESSION_RESTORE && !r->busy)
+        {
+            // Someone else replaced the state, so the history no longer leads to it
+            r->first = r->current;
+            r->save();
+        }
+
+        if (r->next)
+        {
+            r->next(r->nextContext, input, value);
+        }
+    }
+};
+
+#endif
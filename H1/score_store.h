@@ -0,0 +1,488 @@
+// SCORE STORE //
+// Every finished game is appended to a binary log as one fixed-size record
+// with its own CRC32. A background thread does the disk work: at start it
+// reads the whole log, skips any record whose CRC fails, cuts off a torn
+// tail left by a crash (bytes after the last good record, never good records
+// after a damaged one), and builds the index; after that it appends new
+// records in batches, each written with one write and made durable with
+// fsync. A record only counts once its CRC checks out, so a commit is all or
+// nothing.
+//
+// The index lives on the game thread once the load has finished. It is two
+// sorted runs, like a small LSM tree: a big run built by the load (or the last
+// merge) and a small fixed-size run of recent games. top() merges the two and
+// rank() is a binary search in each, so both stay fast over millions of games.
+// Adding a game costs an insertion into the small run; only when that fills up
+// are the runs merged, which is the one step that allocates.
+
+#ifndef TETRIS_SCORE_STORE_H
+#define TETRIS_SCORE_STORE_H
+
+#include "algorithm"
+#include "atomic"
+#include "cerrno"
+#include "condition_variable"
+#include "cstdint"
+#include "cstdio"
+#include "cstring"
+#include "functional"
+#include "mutex"
+#include "thread"
+#include "vector"
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+const uint32_t SCORE_LOG_MAGIC = 0x43535454; // "TTSC" when read as little-endian bytes
+const uint8_t SCORE_LOG_VERSION = 1;
+const int SCORE_LOG_HEADER_BYTES = 8; // magic, version, 3 reserved
+const int SCORE_RECORD_BYTES = 28; // 24 bytes of fields and a CRC32 of them
+const int SCORE_RECENT = 4096; // Size of the small sorted run
+const int SCORE_QUEUE = 256; // Records that can wait for the writer thread
+
+// Struct for one finished game
+struct ScoreRecord
+{
+    int32_t score;
+    int16_t level; // Level the game ended on
+    int16_t startLevel;
+    int32_t lines;
+    uint32_t seed; // Piece sequence seed, so the game can be found among the replays
+    int64_t time; // When it ended (seconds since 1970)
+};
+
+// Struct for the CRC32 (IEEE) lookup table
+struct Crc32Table
+{
+    uint32_t entries[256];
+};
+
+// Function to build the CRC32 lookup table at compile time
+constexpr Crc32Table make_crc32_table()
+{
+    Crc32Table t = {};
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+        {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        t.entries[i] = c;
+    }
+    return t;
+}
+
+constexpr Crc32Table CRC32_TABLE = make_crc32_table();
+
+// Function to get the CRC32 of a block of bytes
+inline uint32_t crc32(const uint8_t* data, size_t length)
+{
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; i++)
+    {
+        c = CRC32_TABLE.entries[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFu;
+}
+
+// Function to write a 32-bit little-endian word
+inline void score_put32(uint8_t* p, uint32_t v)
+{
+    for (int b = 0; b < 4; b++)
+    {
+        p[b] = static_cast<uint8_t>(v >> (8 * b));
+    }
+}
+
+// Function to read a 32-bit little-endian word
+inline uint32_t score_get32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Function to write a record in its on-disk form, CRC included
+inline void score_pack(const ScoreRecord& r, uint8_t* out)
+{
+    score_put32(out, static_cast<uint32_t>(r.score));
+    score_put32(out + 4, static_cast<uint16_t>(r.level) | (static_cast<uint32_t>(static_cast<uint16_t>(r.startLevel)) << 16));
+    score_put32(out + 8, static_cast<uint32_t>(r.lines));
+    score_put32(out + 12, r.seed);
+    score_put32(out + 16, static_cast<uint32_t>(r.time));
+    score_put32(out + 20, static_cast<uint32_t>(static_cast<uint64_t>(r.time) >> 32));
+    score_put32(out + 24, crc32(out, SCORE_RECORD_BYTES - 4));
+}
+
+// Function to read a record in its on-disk form; returns false if its CRC does not match
+inline bool score_unpack(const uint8_t* in, ScoreRecord& r)
+{
+    if (crc32(in, SCORE_RECORD_BYTES - 4) != score_get32(in + 24))
+    {
+        return false;
+    }
+    r.score = static_cast<int32_t>(score_get32(in));
+    uint32_t levels = score_get32(in + 4);
+    r.level = static_cast<int16_t>(levels & 0xFFFF);
+    r.startLevel = static_cast<int16_t>(levels >> 16);
+    r.lines = static_cast<int32_t>(score_get32(in + 8));
+    r.seed = score_get32(in + 12);
+    r.time = static_cast<int64_t>(score_get32(in + 16) | (static_cast<uint64_t>(score_get32(in + 20)) << 32));
+    return true;
+}
+
+// Function to make a file's contents durable
+inline bool score_file_sync(FILE* f)
+{
+    if (fflush(f) != 0)
+    {
+        return false;
+    }
+#if defined(_WIN32)
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
+
+// Function to cut a file back to `size` bytes
+inline bool score_file_truncate(FILE* f, long long size)
+{
+    fflush(f);
+#if defined(_WIN32)
+    return _chsize_s(_fileno(f), size) == 0;
+#else
+    return ftruncate(fileno(f), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+// Function to get a record's index key: higher scores sort higher, and among equal scores the earlier game does
+inline uint64_t score_key(int32_t score, uint32_t index)
+{
+    return (static_cast<uint64_t>(static_cast<uint32_t>(std::max(score, 0))) << 32) | (0xFFFFFFFFu - index);
+}
+
+// Struct for the score log and its index
+struct ScoreStore
+{
+    long long corrupt; // Records the load found damaged and skipped (a torn tail is also cut off the file)
+
+    ScoreStore()
+        : corrupt(0), file(nullptr), loaded(false), adopted(false), failed(false), stopping(false), queueHead(0), queueTail(0), earlyCount(0),
+          recentCount(0)
+    {
+    }
+
+    ~ScoreStore()
+    {
+        close();
+    }
+
+    ScoreStore(const ScoreStore&) = delete;
+    ScoreStore& operator=(const ScoreStore&) = delete;
+
+    // Function to start loading a log (created if missing) on the writer thread; poll() says when it is ready
+    void open(const char* path)
+    {
+        close();
+        std::snprintf(filePath, sizeof(filePath), "%s", path);
+        loaded.store(false);
+        adopted = false;
+        failed = false;
+        stopping = false;
+        queueHead = 0;
+        queueTail = 0;
+        earlyCount = 0;
+        records.clear();
+        sorted.clear();
+        recentCount = 0;
+        corrupt = 0;
+        writer = std::thread([this] { writerLoop(); });
+    }
+
+    // Function to finish writing everything queued and stop the writer thread
+    void close()
+    {
+        if (!writer.joinable())
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        writer.join();
+    }
+
+    // Function to take over the index once the load has finished; returns true on the call where that happens
+    bool poll()
+    {
+        if (adopted || !loaded.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        adopted = true;
+        // Games that ended while the log was still loading go in now
+        for (int i = 0; i < earlyCount; i++)
+        {
+            index(early[i]);
+        }
+        earlyCount = 0;
+        return true;
+    }
+
+    // Function to tell whether the index is ready to query
+    bool ready() const
+    {
+        return adopted;
+    }
+
+    // Function to record a finished game: queued for the disk, and added to the index (or held until it is ready)
+    void add(const ScoreRecord& r)
+    {
+        push(r);
+        if (adopted)
+        {
+            index(r);
+        }
+        else if (earlyCount < SCORE_QUEUE)
+        {
+            early[earlyCount++] = r;
+        }
+    }
+
+    long long count() const
+    {
+        return static_cast<long long>(records.size());
+    }
+
+    // Function to get the best score, or 0 with no games
+    int best() const
+    {
+        uint64_t top = 0;
+        if (!sorted.empty())
+        {
+            top = sorted[0];
+        }
+        if (recentCount > 0)
+        {
+            top = std::max(top, recent[0]);
+        }
+        return static_cast<int>(top >> 32);
+    }
+
+    // Function to get the place a score would take: 1 + the number of games with a strictly higher score
+    long long rank(int score) const
+    {
+        uint64_t bound = score_key(score, 0); // The highest key a game with this score can have
+        std::greater<uint64_t> higher;
+        long long above = std::lower_bound(sorted.begin(), sorted.end(), bound, higher) - sorted.begin();
+        above += std::lower_bound(recent, recent + recentCount, bound, higher) - recent;
+        return above + 1;
+    }
+
+    // Function to copy the best `k` games, best first, into `out`; returns how many there were
+    int top(int k, ScoreRecord* out) const
+    {
+        size_t a = 0;
+        int b = 0;
+        int n = 0;
+        while (n < k && (a < sorted.size() || b < recentCount))
+        {
+            bool takeSorted = b == recentCount || (a < sorted.size() && sorted[a] > recent[b]);
+            uint64_t key = takeSorted ? sorted[a++] : recent[b++];
+            out[n++] = records[0xFFFFFFFFu - static_cast<uint32_t>(key)];
+        }
+        return n;
+    }
+
+    // Function to tell whether the log could not be opened, was not a score log of this version, or could not be written
+    bool error() const
+    {
+        return failed;
+    }
+
+private:
+    char filePath[512];
+    FILE* file; // Only touched by the writer thread
+    std::atomic<bool> loaded; // The writer thread has built the index
+    bool adopted; // The game thread has taken the index over
+    std::atomic<bool> failed;
+    bool stopping;
+    std::thread writer;
+    std::mutex lock;
+    std::condition_variable wake; // Signalled when a record is queued
+    std::condition_variable space; // Signalled when the writer takes records
+    ScoreRecord queue[SCORE_QUEUE]; // Ring of records waiting to be written
+    int queueHead;
+    int queueTail;
+    ScoreRecord early[SCORE_QUEUE]; // Games added before the index was ready
+    int earlyCount;
+
+    std::vector<ScoreRecord> records; // Every game, in log order
+    std::vector<uint64_t> sorted; // Keys of the big run, best first
+    uint64_t recent[SCORE_RECENT]; // Keys of the small run, best first
+    int recentCount;
+
+    // Function to add a record that is already in `records` order to the index
+    void index(const ScoreRecord& r)
+    {
+        if (recentCount == SCORE_RECENT)
+        {
+            merge();
+        }
+        if (records.size() == records.capacity())
+        {
+            records.reserve(records.size() + SCORE_RECENT);
+        }
+        uint64_t key = score_key(r.score, static_cast<uint32_t>(records.size()));
+        records.push_back(r);
+
+        // Insertion into the small run, which is at most SCORE_RECENT keys
+        int i = recentCount++;
+        while (i > 0 && recent[i - 1] < key)
+        {
+            recent[i] = recent[i - 1];
+            i--;
+        }
+        recent[i] = key;
+    }
+
+    // Function to fold the small run into the big one
+    void merge()
+    {
+        std::vector<uint64_t> merged(sorted.size() + recentCount);
+        std::merge(sorted.begin(), sorted.end(), recent, recent + recentCount, merged.begin(), std::greater<uint64_t>());
+        sorted.swap(merged);
+        recentCount = 0;
+        records.reserve(records.size() + SCORE_RECENT);
+    }
+
+    void push(const ScoreRecord& r)
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            space.wait(guard, [this] { return (queueTail + 1) % SCORE_QUEUE != queueHead; });
+            queue[queueTail] = r;
+            queueTail = (queueTail + 1) % SCORE_QUEUE;
+        }
+        wake.notify_one();
+    }
+
+    // Function run on the writer thread before it starts appending: read the log and build the index
+    void load()
+    {
+        file = fopen(filePath, "r+b");
+        if (!file && errno == ENOENT)
+        {
+            file = fopen(filePath, "w+b"); // Only when there is no log yet, since "w" empties an existing file
+        }
+        if (!file)
+        {
+            failed = true;
+            return;
+        }
+        fseek(file, 0, SEEK_END);
+        long long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        std::vector<uint8_t> bytes(static_cast<size_t>(std::max(size, 0LL)));
+        if (size > 0 && fread(bytes.data(), 1, bytes.size(), file) != bytes.size())
+        {
+            failed = true;
+            return;
+        }
+
+        if (size > 0 && (size < SCORE_LOG_HEADER_BYTES || score_get32(bytes.data()) != SCORE_LOG_MAGIC || bytes[4] != SCORE_LOG_VERSION))
+        {
+            // Not a log this version can read (another format, a newer version or the wrong file): leave it untouched
+            fclose(file);
+            file = nullptr;
+            failed = true;
+            return;
+        }
+        if (size == 0)
+        {
+            // New log: write its header
+            uint8_t header[SCORE_LOG_HEADER_BYTES] = {};
+            score_put32(header, SCORE_LOG_MAGIC);
+            header[4] = SCORE_LOG_VERSION;
+            score_file_truncate(file, 0);
+            fseek(file, 0, SEEK_SET);
+            fwrite(header, 1, SCORE_LOG_HEADER_BYTES, file);
+            failed = !score_file_sync(file);
+            return;
+        }
+
+        size_t n = (bytes.size() - SCORE_LOG_HEADER_BYTES) / SCORE_RECORD_BYTES;
+        records.reserve(n + SCORE_RECENT);
+        sorted.reserve(n);
+        size_t good = SCORE_LOG_HEADER_BYTES; // End of the last good record
+        for (size_t i = 0; i < n; i++)
+        {
+            ScoreRecord r;
+            if (!score_unpack(&bytes[SCORE_LOG_HEADER_BYTES + i * SCORE_RECORD_BYTES], r))
+            {
+                // A damaged record in the middle is skipped; the records after it are still good
+                corrupt++;
+                continue;
+            }
+            sorted.push_back(score_key(r.score, static_cast<uint32_t>(records.size())));
+            records.push_back(r);
+            good = SCORE_LOG_HEADER_BYTES + (i + 1) * SCORE_RECORD_BYTES;
+        }
+        std::sort(sorted.begin(), sorted.end(), std::greater<uint64_t>());
+
+        // Only damaged records and a partial one follow the last good record: a torn write, cut off so appends follow good data
+        if (good < bytes.size())
+        {
+            corrupt += (bytes.size() - SCORE_LOG_HEADER_BYTES) % SCORE_RECORD_BYTES ? 1 : 0; // The partial record; whole ones were counted above
+            score_file_truncate(file, static_cast<long long>(good));
+        }
+        fseek(file, 0, SEEK_END);
+    }
+
+    // Function run by the writer thread
+    void writerLoop()
+    {
+        load();
+        loaded.store(true, std::memory_order_release);
+
+        uint8_t batch[SCORE_QUEUE * SCORE_RECORD_BYTES];
+        while (true)
+        {
+            int count = 0;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [this] { return stopping || queueHead != queueTail; });
+                if (queueHead == queueTail)
+                {
+                    break;
+                }
+                while (queueHead != queueTail)
+                {
+                    score_pack(queue[queueHead], batch + count * SCORE_RECORD_BYTES);
+                    queueHead = (queueHead + 1) % SCORE_QUEUE;
+                    count++;
+                }
+            }
+            space.notify_all();
+
+            // One write and one sync per batch: records before the sync may be lost in a crash, but never half-written
+            if (file && !failed)
+            {
+                size_t bytes = static_cast<size_t>(count) * SCORE_RECORD_BYTES;
+                failed = fwrite(batch, 1, bytes, file) != bytes || !score_file_sync(file);
+            }
+        }
+        if (file)
+        {
+            fclose(file);
+            file = nullptr;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,349 @@
+// SESSION PROTOCOL //
+// The messages between a game server that runs sessions and its clients.
+// A client sends one byte per input: a GameAction, soft drop on or off, or a
+// restart. The server applies every input that arrived before a tick at the
+// start of that tick. After a tick that changed what the client can see, the
+// server sends a frame:
+//
+//   length (1 byte, payload bytes that follow)
+//   flags (1 byte, DELTA_*)
+//   varint: ticks since the previous frame
+//   DELTA_PIECE  shape << 2 | rotation, x + 4, y + 4
+//   DELTA_ROWS   row count, then per row: y and the 10 cell colours as nibbles (5 bytes)
+//   DELTA_STATS  varint score, varint lines, level
+//   DELTA_HASH   the board's Zobrist hash (8 bytes), every NET_HASH_TICKS ticks
+//
+// DeltaEncoder remembers what it last sent, so a frame carries only the piece,
+// rows and stats that changed; a tick that only counted towards gravity sends
+// nothing. SessionMirror rebuilds the visible state from the frames on the
+// client and checks it against each hash the server sends. Both work on the
+// classic board size.
+
+#ifndef TETRIS_SESSION_PROTOCOL_H
+#define TETRIS_SESSION_PROTOCOL_H
+
+#include "cstdint"
+#include "cstring"
+#include "game_session.h"
+
+// Input bytes beyond the GameAction values (the same numbers replays use)
+enum NetInput
+{
+    NET_SOFT_DROP_ON = 5,
+    NET_SOFT_DROP_OFF = 6,
+    NET_RESTART = 7 // Start a new game at the same level with the next seed
+};
+
+// Parts a frame carries
+const uint8_t DELTA_PIECE = 1 << 0;
+const uint8_t DELTA_ROWS = 1 << 1;
+const uint8_t DELTA_STATS = 1 << 2;
+const uint8_t DELTA_GAME_OVER = 1 << 3; // The game has ended (no payload)
+const uint8_t DELTA_HASH = 1 << 4;
+const uint8_t DELTA_NEW_GAME = 1 << 5; // Clear the board before applying the rest (no payload)
+
+const int NET_HASH_TICKS = 60; // Ticks between board hashes (one second)
+const int NET_ROW_BYTES = 1 + GRID_WIDTH / 2; // y, then two cells per byte
+const int NET_FRAME_MAX = 1 + 1 + 5 + 3 + 1 + GRID_HEIGHT * NET_ROW_BYTES + 5 + 5 + 1 + 8; // Largest frame with its length byte
+
+static_assert(GRID_WIDTH % 2 == 0, "Rows are sent as two cells per byte");
+static_assert(NET_FRAME_MAX - 1 <= 255, "A frame's length must fit in its length byte");
+
+// Function to write a varint; returns the bytes written
+inline int net_put_varint(uint8_t* out, uint32_t v)
+{
+    int n = 0;
+    while (v >= 0x80)
+    {
+        out[n++] = static_cast<uint8_t>(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = static_cast<uint8_t>(v);
+    return n;
+}
+
+// Function to read a varint from in[at..end); returns false if it runs past the end
+inline bool net_get_varint(const uint8_t* in, int& at, int end, uint32_t& v)
+{
+    v = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        if (at >= end)
+        {
+            return false;
+        }
+        uint8_t b = in[at++];
+        v |= static_cast<uint32_t>(b & 0x7F) << shift;
+        if (!(b & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Struct for the server side of one connection: what the client has been sent so far
+struct DeltaEncoder
+{
+    uint8_t sentColors[GRID_HEIGHT][GRID_WIDTH];
+    uint64_t sentHash;
+    Tetromino sentPiece;
+    int sentScore, sentLines, sentLevel;
+    bool sentGameOver;
+    bool newGame; // The next frame starts a new game
+    uint32_t ticksSinceFrame;
+    uint32_t ticksSinceHash;
+
+    DeltaEncoder()
+    {
+        reset();
+    }
+
+    // Function to forget what was sent, so the next frame describes the whole state of a new game
+    void reset()
+    {
+        memset(sentColors, 0, sizeof(sentColors));
+        sentHash = 0;
+        sentPiece = Tetromino(-1, 0, 0, 0);
+        sentScore = -1;
+        sentLines = -1;
+        sentLevel = -1;
+        sentGameOver = false;
+        newGame = true;
+        ticksSinceFrame = 0;
+        ticksSinceHash = NET_HASH_TICKS;
+    }
+
+    // Function to write the frame for one tick of `s` into out (at least NET_FRAME_MAX bytes); returns its size, 0 if nothing changed
+    int encode(const GameSession& s, uint8_t* out)
+    {
+        ticksSinceFrame++;
+        ticksSinceHash++;
+
+        const Tetromino& p = s.currentPiece;
+        uint8_t flags = newGame ? DELTA_NEW_GAME : 0;
+        if (p.shape != sentPiece.shape || p.rotation != sentPiece.rotation || p.pos.x != sentPiece.pos.x || p.pos.y != sentPiece.pos.y)
+        {
+            flags |= DELTA_PIECE;
+        }
+        if (s.board.hash != sentHash || newGame)
+        {
+            flags |= DELTA_ROWS;
+        }
+        if (s.stats.score != sentScore || s.stats.linesCleared != sentLines || s.stats.level != sentLevel)
+        {
+            flags |= DELTA_STATS;
+        }
+        if (s.gameOver && !sentGameOver)
+        {
+            flags |= DELTA_GAME_OVER;
+        }
+        if (ticksSinceHash >= NET_HASH_TICKS && flags)
+        {
+            flags |= DELTA_HASH;
+        }
+        if (!flags)
+        {
+            return 0;
+        }
+
+        int n = 1;
+        out[n++] = flags;
+        n += net_put_varint(out + n, ticksSinceFrame);
+        ticksSinceFrame = 0;
+
+        if (flags & DELTA_PIECE)
+        {
+            out[n++] = static_cast<uint8_t>(p.shape << 2 | p.rotation);
+            out[n++] = static_cast<uint8_t>(p.pos.x + 4);
+            out[n++] = static_cast<uint8_t>(p.pos.y + 4);
+            sentPiece = p;
+        }
+        if (flags & DELTA_ROWS)
+        {
+            // A changed hash means cells moved; only the rows whose colours differ are sent
+            int countAt = n++;
+            int count = 0;
+            for (int y = 0; y < GRID_HEIGHT; y++)
+            {
+                if (memcmp(sentColors[y], s.board.colors[y], GRID_WIDTH) == 0)
+                {
+                    continue;
+                }
+                memcpy(sentColors[y], s.board.colors[y], GRID_WIDTH);
+                out[n++] = static_cast<uint8_t>(y);
+                for (int x = 0; x < GRID_WIDTH; x += 2)
+                {
+                    out[n++] = static_cast<uint8_t>(s.board.colors[y][x] | s.board.colors[y][x + 1] << 4);
+                }
+                count++;
+            }
+            out[countAt] = static_cast<uint8_t>(count);
+            sentHash = s.board.hash;
+        }
+        if (flags & DELTA_STATS)
+        {
+            n += net_put_varint(out + n, static_cast<uint32_t>(s.stats.score));
+            n += net_put_varint(out + n, static_cast<uint32_t>(s.stats.linesCleared));
+            out[n++] = static_cast<uint8_t>(s.stats.level);
+            sentScore = s.stats.score;
+            sentLines = s.stats.linesCleared;
+            sentLevel = s.stats.level;
+        }
+        if (flags & DELTA_HASH)
+        {
+            for (int i = 0; i < 8; i++)
+            {
+                out[n++] = static_cast<uint8_t>(s.board.hash >> (8 * i));
+            }
+            ticksSinceHash = 0;
+        }
+        sentGameOver = sentGameOver || (flags & DELTA_GAME_OVER);
+        newGame = false;
+
+        out[0] = static_cast<uint8_t>(n - 1);
+        return n;
+    }
+};
+
+// Struct for the client side of one connection: the visible state rebuilt from frames
+struct SessionMirror
+{
+    uint8_t colors[GRID_HEIGHT][GRID_WIDTH];
+    Tetromino piece;
+    int score, lines, level;
+    bool gameOver;
+    long long tick; // Server tick of the last frame
+    long long frames;
+    long long hashChecks;
+    long long hashMismatches; // Hashes that did not match the rebuilt board (should stay 0)
+
+    SessionMirror() : score(0), lines(0), level(1), gameOver(false), tick(0), frames(0), hashChecks(0), hashMismatches(0)
+    {
+        memset(colors, 0, sizeof(colors));
+    }
+
+    // Function to get the Zobrist hash of the rebuilt board
+    uint64_t hash() const
+    {
+        uint64_t h = 0;
+        for (int y = 0; y < GRID_HEIGHT; y++)
+        {
+            for (int x = 0; x < GRID_WIDTH; x++)
+            {
+                if (colors[y][x])
+                {
+                    h ^= BOARD_KEYS.cells[y][x];
+                }
+            }
+        }
+        return h;
+    }
+
+    // Function to apply every whole frame in in[0..size); returns the bytes used (a partial frame is left), or -1 if a frame is malformed
+    int apply(const uint8_t* in, int size)
+    {
+        int used = 0;
+        while (used < size && used + 1 + in[used] <= size)
+        {
+            int end = used + 1 + in[used];
+            if (!applyFrame(in, used + 1, end))
+            {
+                return -1;
+            }
+            used = end;
+        }
+        return used;
+    }
+
+private:
+    // Function to apply the payload in[at..end) of one frame
+    bool applyFrame(const uint8_t* in, int at, int end)
+    {
+        if (at >= end)
+        {
+            return false;
+        }
+        uint8_t flags = in[at++];
+        uint32_t ticks;
+        if (!net_get_varint(in, at, end, ticks))
+        {
+            return false;
+        }
+        tick += ticks;
+        frames++;
+
+        if (flags & DELTA_NEW_GAME)
+        {
+            memset(colors, 0, sizeof(colors));
+            gameOver = false;
+        }
+        if (flags & DELTA_PIECE)
+        {
+            if (at + 3 > end)
+            {
+                return false;
+            }
+            piece = Tetromino(in[at] >> 2, in[at] & 3, in[at + 1] - 4, in[at + 2] - 4);
+            at += 3;
+        }
+        if (flags & DELTA_ROWS)
+        {
+            if (at >= end)
+            {
+                return false;
+            }
+            int count = in[at++];
+            if (at + count * NET_ROW_BYTES > end)
+            {
+                return false;
+            }
+            for (int r = 0; r < count; r++, at += NET_ROW_BYTES)
+            {
+                int y = in[at];
+                if (y >= GRID_HEIGHT)
+                {
+                    return false;
+                }
+                for (int x = 0; x < GRID_WIDTH; x += 2)
+                {
+                    colors[y][x] = in[at + 1 + x / 2] & 15;
+                    colors[y][x + 1] = in[at + 1 + x / 2] >> 4;
+                }
+            }
+        }
+        if (flags & DELTA_STATS)
+        {
+            uint32_t s, l;
+            if (!net_get_varint(in, at, end, s) || !net_get_varint(in, at, end, l) || at >= end)
+            {
+                return false;
+            }
+            score = static_cast<int>(s);
+            lines = static_cast<int>(l);
+            level = in[at++];
+        }
+        if (flags & DELTA_GAME_OVER)
+        {
+            gameOver = true;
+        }
+        if (flags & DELTA_HASH)
+        {
+            if (at + 8 > end)
+            {
+                return false;
+            }
+            uint64_t h = 0;
+            for (int i = 0; i < 8; i++)
+            {
+                h |= static_cast<uint64_t>(in[at + i]) << (8 * i);
+            }
+            at += 8;
+            hashChecks++;
+            hashMismatches += h != hash();
+        }
+        return at == end;
+    }
+};
+
+#endif
@@ -0,0 +1,180 @@
+// SHAPE TABLES //
+// SHAPES is the readable source of truth. Everything the game queries at run
+// time (row masks, cell lists, extents) is generated from it at compile time.
+
+#ifndef TETRIS_SHAPES_H
+#define TETRIS_SHAPES_H
+
+#include "cstdint"
+
+// SHAPE DEFINITIONS
+// SHAPES[shape][rotation][y][x]: 7 shapes, 4 rotations, 4x4 grid for each
+constexpr int SHAPES[7][4][4][4] =
+{
+    // I shape
+    {
+        { {0,0,0,0}, {1,1,1,1}, {0,0,0,0}, {0,0,0,0} },
+        { {0,0,1,0}, {0,0,1,0}, {0,0,1,0}, {0,0,1,0} },
+        { {0,0,0,0}, {0,0,0,0}, {1,1,1,1}, {0,0,0,0} },
+        { {0,1,0,0}, {0,1,0,0}, {0,1,0,0}, {0,1,0,0} }
+    },
+    // J shape
+    {
+        { {1,0,0,0}, {1,1,1,0}, {0,0,0,0}, {0,0,0,0} },
+        { {0,1,1,0}, {0,1,0,0}, {0,1,0,0}, {0,0,0,0} },
+        { {0,0,0,0}, {1,1,1,0}, {0,0,1,0}, {0,0,0,0} },
+        { {0,1,0,0}, {0,1,0,0}, {1,1,0,0}, {0,0,0,0} }
+    },
+    // L shape
+    {
+        { {0,0,1,0}, {1,1,1,0}, {0,0,0,0}, {0,0,0,0} },
+        { {0,1,0,0}, {0,1,0,0}, {0,1,1,0}, {0,0,0,0} },
+        { {0,0,0,0}, {1,1,1,0}, {1,0,0,0}, {0,0,0,0} },
+        { {1,1,0,0}, {0,1,0,0}, {0,1,0,0}, {0,0,0,0} }
+    },
+    // O shape (square)
+    {
+        { {1,1,0,0}, {1,1,0,0}, {0,0,0,0}, {0,0,0,0} },
+        { {1,1,0,0}, {1,1,0,0}, {0,0,0,0}, {0,0,0,0} },
+        { {1,1,0,0}, {1,1,0,0}, {0,0,0,0}, {0,0,0,0} },
+        { {1,1,0,0}, {1,1,0,0}, {0,0,0,0}, {0,0,0,0} }
+    },
+    // S shape
+    {
+        { {0,1,1,0}, {1,1,0,0}, {0,0,0,0}, {0,0,0,0} },
+        { {0,1,0,0}, {0,1,1,0}, {0,0,1,0}, {0,0,0,0} },
+        { {0,0,0,0}, {0,1,1,0}, {1,1,0,0}, {0,0,0,0} },
+        { {1,0,0,0}, {1,1,0,0}, {0,1,0,0}, {0,0,0,0} }
+    },
+    // T shape
+    {
+        { {0,1,0,0}, {1,1,1,0}, {0,0,0,0}, {0,0,0,0} },
+        { {0,1,0,0}, {0,1,1,0}, {0,1,0,0}, {0,0,0,0} },
+        { {0,0,0,0}, {1,1,1,0}, {0,1,0,0}, {0,0,0,0} },
+        { {0,1,0,0}, {1,1,0,0}, {0,1,0,0}, {0,0,0,0} }
+    },
+    // Z shape
+    {
+        { {1,1,0,0}, {0,1,1,0}, {0,0,0,0}, {0,0,0,0} },
+        { {0,0,1,0}, {0,1,1,0}, {0,1,0,0}, {0,0,0,0} },
+        { {0,0,0,0}, {1,1,0,0}, {0,1,1,0}, {0,0,0,0} },
+        { {0,1,0,0}, {1,1,0,0}, {1,0,0,0}, {0,0,0,0} }
+    }
+};
+
+// Struct for one filled cell, relative to the top-left of the 4x4 grid
+struct CellOffset
+{
+    int8_t x, y;
+};
+
+// Struct for everything the game needs to know about one shape rotation
+struct ShapeInfo
+{
+    uint8_t rowMasks[4]; // Filled columns of each row, shifted so bit 0 is column minX
+    CellOffset cells[4]; // The four filled cells in row-major order
+    int8_t minX, maxX; // Left and right extents inside the 4x4 grid
+    int8_t minY, maxY; // Top and bottom extents inside the 4x4 grid
+    int8_t bottom[4]; // Lowest filled row of each 4x4 column, -1 if the column is empty
+};
+
+// Function to build the info for one shape rotation from SHAPES
+constexpr ShapeInfo make_shape_info(int shape, int rotation)
+{
+    ShapeInfo info = {};
+    info.minX = 4;
+    info.minY = 4;
+    info.maxX = -1;
+    info.maxY = -1;
+
+    int count = 0;
+    for (int x = 0; x < 4; x++)
+    {
+        info.bottom[x] = -1;
+    }
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 4; x++)
+        {
+            if (SHAPES[shape][rotation][y][x])
+            {
+                info.cells[count].x = static_cast<int8_t>(x);
+                info.cells[count].y = static_cast<int8_t>(y);
+                count++;
+
+                if (x < info.minX) info.minX = static_cast<int8_t>(x);
+                if (x > info.maxX) info.maxX = static_cast<int8_t>(x);
+                if (y < info.minY) info.minY = static_cast<int8_t>(y);
+                if (y > info.maxY) info.maxY = static_cast<int8_t>(y);
+                info.bottom[x] = static_cast<int8_t>(y);
+            }
+        }
+    }
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = info.minX; x < 4; x++)
+        {
+            if (SHAPES[shape][rotation][y][x])
+            {
+                info.rowMasks[y] |= static_cast<uint8_t>(1u << (x - info.minX));
+            }
+        }
+    }
+    return info;
+}
+
+// Struct wrapping the full table so it can be built as a single constexpr value
+struct ShapeTable
+{
+    ShapeInfo info[7][4];
+};
+
+// Function to build the info for every shape and rotation
+constexpr ShapeTable make_shape_table()
+{
+    ShapeTable table = {};
+    for (int s = 0; s < 7; s++)
+    {
+        for (int r = 0; r < 4; r++)
+        {
+            table.info[s][r] = make_shape_info(s, r);
+        }
+    }
+    return table;
+}
+
+constexpr ShapeTable SHAPE_TABLE = make_shape_table();
+
+// Checks that every shape rotation in SHAPES has exactly four cells
+constexpr bool shapes_are_valid()
+{
+    for (int s = 0; s < 7; s++)
+    {
+        for (int r = 0; r < 4; r++)
+        {
+            int count = 0;
+            for (int y = 0; y < 4; y++)
+            {
+                for (int x = 0; x < 4; x++)
+                {
+                    count += SHAPES[s][r][y][x] ? 1 : 0;
+                }
+            }
+            if (count != 4)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(shapes_are_valid(), "Every tetromino rotation must have exactly four cells");
+
+// Function to look up the generated info for a shape rotation
+inline const ShapeInfo& shape_info(int shape, int rotation)
+{
+    return SHAPE_TABLE.info[shape][rotation];
+}
+
+#endif
@@ -2,61 +2,38 @@
 
 #include "splashkit.h"
 #include "vector"
+#include "memory"
+#include "atomic"
+#include "thread"
 #include "ctime"
+#include "chrono"
+#include "cstdio"
+#include "cstring"
+#include "ai.h"
+#include "alloc_tracker.h"
+#include "input.h"
+#include "profiler.h"
+#include "replay.h"
+#include "rollback.h"
+#include "score_store.h"
 
 using namespace std;
 
 // Constants
 
 const int CELL_SIZE = 30; // Size of each cell in the grid
-const int GRID_WIDTH = 10; // Number of columns in the grid
-const int GRID_HEIGHT = 20; // Number of rows in the grid
 const int SCREEN_WIDTH = CELL_SIZE * GRID_WIDTH; // Width of the grid
 const int SCREEN_HEIGHT = CELL_SIZE * GRID_HEIGHT; // Height of the grid
 const int SIDEBAR_WIDTH = 200; // Width of the sidebar
 const int WINDOW_WIDTH = SCREEN_WIDTH + SIDEBAR_WIDTH; // Total window width (grid + sidebar)
 const int WINDOW_HEIGHT = SCREEN_HEIGHT; // Total window height
-const int MAX_LEVEL = 5; // Maximum selectable starting level
+const double TICK_SECONDS = 1.0 / 60.0; // Length of one simulation tick (the game rules are tuned for 60 ticks per second)
+const int MAX_TICKS_PER_FRAME = 8; // After a longer stall the backlog is dropped instead of fast-forwarding the game
+const unsigned int RENDER_FPS_CAP = 0; // Frame rate cap for refresh_screen, 0 = uncapped (vsync still applies if the driver enables it)
+const int REWIND_TICKS = 60; // Ticks one press of Backspace goes back (one second)
+const RandomizerKind PIECE_RANDOMIZER = RANDOMIZER_UNIFORM; // How pieces are picked; RANDOMIZER_BAG deals each shape once per 7 pieces
 
 // STRUCTS
-// Struct for position on the grid
-struct Position 
-{
-    int x, y;
-    Position(int x = 0, int y = 0) : x(x), y(y) {}
-};
-
-// Struct for tetromino details
-struct Tetromino 
-{
-    int shape;      // Shape index
-    int rotation;   // Rotation index 
-    Position pos;   // Top-left position of the 4x4 tetromino grid
-
-    Tetromino(int shape = 0, int rotation = 0, int x = 3, int y = 0) : shape(shape), rotation(rotation), pos(x, y) {}
-};
-
-// Struct for game stats
-struct GameStats 
-{
-    int score;
-    int level;
-    int linesCleared;
-    int highScore;
-    double gameTime;
-
-    GameStats() : score(0), level(1), linesCleared(0), highScore(0), gameTime(0) {}
-
-    // Reset stats for a new game, starting at a given level
-    void reset(int startLevel) 
-    {
-        score = 0;
-        level = startLevel;
-        linesCleared = 0;
-        gameTime = 0;
-    }
-};
-
 // Holds the current game stat
 struct GameState 
 {
@@ -64,10 +41,11 @@ struct GameState
     bool gamePaused;
     bool gameOver;
     bool showLevelSelect;
+    bool autoPlay;
     int selectedLevel;
     double startTime;
 
-    GameState() : gameStarted(false), gamePaused(false), gameOver(false), showLevelSelect(true), selectedLevel(1), startTime(0) {}
+    GameState() : gameStarted(false), gamePaused(false), gameOver(false), showLevelSelect(true), autoPlay(false), selectedLevel(1), startTime(0) {}
 
     // Function to start a new game
     void startGame() 
@@ -98,272 +76,641 @@ struct GameState
     }
 };
 
+const int MUSIC_FADE_MS = 2000; // Length of the music fade in and out
+const int SOUND_VOICES = 4; // Most sound effects started in one frame; the rest are dropped
+const double LOGO_SCALE = 0.40; // The logo is drawn at this size; it is scaled once when it loads
+
 // Struct to hold all loaded audio and image assets, and music fade state
 struct Assets 
 {
     bitmap background;
-    bitmap logo;
+    bitmap logo; // Already scaled to LOGO_SCALE
+    double logoX, logoY; // Where the logo is drawn
     sound_effect click_sfx;
     sound_effect clear_line_sfx;
     music bgm;
-    bool fading_out;
-    float fade_volume;
+    bool fading_out; // The music is fading out after game over
+    bool ready; // Audio has loaded; nothing plays and the game cannot start before this
+    std::thread audioLoader;
+    std::atomic<bool> audioLoaded;
+
+    Assets() : background(nullptr), logo(nullptr), logoX(0), logoY(0), click_sfx(nullptr), clear_line_sfx(nullptr), bgm(nullptr),
+               fading_out(false), ready(false), audioLoaded(false) {}
+
+    ~Assets()
+    {
+        if (audioLoader.joinable())
+        {
+            audioLoader.join();
+        }
+    }
 
-    Assets() : fading_out(false), fade_volume(0.0f) {}
+    // Function to start decoding the music and sound effects on a background thread.
+    // Only audio can load there: SplashKit bitmaps are GPU textures and must be created on the main thread.
+    void startAudio()
+    {
+        audioLoader = std::thread([this]()
+        {
+            load_music("bgm", "music.mp3");
+            load_sound_effect("click", "click.mp3");
+            load_sound_effect("clear", "clear.mp3");
+            audioLoaded.store(true, std::memory_order_release);
+        });
+    }
 
-    // Load all required assets from files
-    void initialize() {
+    // Function to load the images, scaling the logo once here rather than every frame it is drawn
+    void loadImages()
+    {
         background = load_bitmap("background", "background.jpg");
-        logo = load_bitmap("logo", "logo.png");
 
-        load_music("bgm", "music.mp3");
-        load_sound_effect("click", "click.mp3");
-        load_sound_effect("clear", "clear.mp3");
+        bitmap source = load_bitmap("logo_source", "logo.png");
+        int sourceW = bitmap_width(source);
+        int sourceH = bitmap_height(source);
+        int w = static_cast<int>(sourceW * LOGO_SCALE);
+        int h = static_cast<int>(sourceH * LOGO_SCALE);
+        logo = create_bitmap("logo", w, h);
+        clear_bitmap(logo, COLOR_TRANSPARENT);
+        // SplashKit scales about the bitmap's centre, so shift it by the shrinkage to land in the corner
+        draw_bitmap_on_bitmap(logo, source, (w - sourceW) / 2.0, (h - sourceH) / 2.0, option_scale_bmp(LOGO_SCALE, LOGO_SCALE));
+        free_bitmap(source);
+
+        // Same spot the logo used to appear when it was scaled while drawing
+        logoX = (SCREEN_WIDTH - w) / 2 - 228 + (sourceW - w) / 2.0;
+        logoY = 20 + (sourceH - h) / 2.0;
+    }
 
+    // Function to finish loading once the audio thread is done (the completion barrier); returns true on the frame it happens
+    bool poll()
+    {
+        if (ready || !audioLoaded.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        audioLoader.join();
         bgm = music_named("bgm");
         click_sfx = sound_effect_named("click");
         clear_line_sfx = sound_effect_named("clear");
+        ready = true;
+        return true;
+    }
+};
+
+// Struct for the sound effect voices. An effect starts at the event that
+// triggers it, as soon as gameplay asks for it. An effect triggered again in
+// the same frame is not restarted, and at most SOUND_VOICES start per frame.
+struct SoundMixer
+{
+    sound_effect started[SOUND_VOICES]; // Effects started this frame
+    int count;
+    long long played;
+    long long dropped; // Triggers lost to the voice limit
+
+    SoundMixer() : count(0), played(0), dropped(0) {}
+
+    // Function to start an effect now, unless it already started this frame or every voice is used
+    void trigger(sound_effect effect)
+    {
+        if (!effect)
+        {
+            return;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            if (started[i] == effect)
+            {
+                return;
+            }
+        }
+        if (count == SOUND_VOICES)
+        {
+            dropped++;
+            return;
+        }
+        play_sound_effect(effect);
+        started[count++] = effect;
+        played++;
+    }
+
+    // Function to free the voices for the next frame
+    void endFrame()
+    {
+        count = 0;
     }
 };
 
-// Struct for handle timing for piece drop and frame delta calculation
+// Function to get the time in seconds from a monotonic clock with sub-millisecond precision
+double now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Struct for handle frame delta calculation
 struct GameTimer 
 {
-    int dropTimer; // Counts frames for automatic drop
-    double lastTime; // Last frame time (seconds)
+    double lastTime; // Last frame time (seconds, from now_seconds)
 
-    GameTimer() : dropTimer(0), lastTime(current_ticks() / 1000.0) {}
+    GameTimer() : lastTime(now_seconds()) {}
 
     // Function to reset timers for a new game
     void reset() {
-        dropTimer = 0;
-        lastTime = current_ticks() / 1000.0;
+        lastTime = now_seconds();
     }
 
     // Function to get time elapsed since last frame=
     double getDeltaTime() 
     {
-        double now = current_ticks() / 1000.0;
+        double now = now_seconds();
         double dt = now - lastTime;
         lastTime = now;
         return dt;
     }
 };
 
+// Struct for the fixed-timestep simulation clock. Frame time goes into an
+// accumulator and comes out as whole ticks, so the game runs at the same speed
+// whatever the render rate; the leftover fraction is used to interpolate drawing.
+struct SimulationClock
+{
+    double accumulator; // Elapsed time not yet simulated (seconds)
+
+    SimulationClock() : accumulator(0) {}
+
+    // Function to forget any leftover time (new game)
+    void reset()
+    {
+        accumulator = 0;
+    }
+
+    // Function to add a frame's elapsed time and get the number of ticks to run for it
+    int advance(double dt)
+    {
+        accumulator += dt;
+        int ticks = static_cast<int>(accumulator / TICK_SECONDS);
+        if (ticks > MAX_TICKS_PER_FRAME)
+        {
+            ticks = MAX_TICKS_PER_FRAME;
+            accumulator = 0;
+        }
+        else
+        {
+            accumulator -= ticks * TICK_SECONDS;
+        }
+        return ticks;
+    }
+
+    // Function to get the time tick `index` of the `ticks` just returned by advance() stands for, given the frame time
+    double tickTime(double now, int index, int ticks) const
+    {
+        return now - accumulator - (ticks - 1 - index) * TICK_SECONDS;
+    }
+
+    // Function to get how far the current time is between the last tick and the next (0 to 1)
+    double alpha() const
+    {
+        return accumulator / TICK_SECONDS;
+    }
+};
+
 // GLOBAL GAME OBJECTS
-GameStats stats; // Holds score, level, etc.
+GameSession session; // Holds the board, falling piece, score, level, etc.
 GameState state; // Holds flags and level selection
 Assets assets; // Holds images and sounds
-GameTimer gameTimer; // Handles drop and frame timing
-Tetromino currentPiece; // The currently falling tetromino
-
-vector<vector<int>> board(GRID_HEIGHT, vector<int>(GRID_WIDTH, 0)); // 2D grid representing the game board
-
-// SHAPE DEFINITIONS 
-// SHAPES[shape][rotation][y][x]: 7 shapes, 4 rotations, 4x4 grid for each
-const int SHAPES[7][4][4][4] =
-{
-    // I shape 
-    {
-        { {0,0,0,0}, {1,1,1,1}, {0,0,0,0}, {0,0,0,0} }, 
-        { {0,0,1,0}, {0,0,1,0}, {0,0,1,0}, {0,0,1,0} }, 
-        { {0,0,0,0}, {0,0,0,0}, {1,1,1,1}, {0,0,0,0} }, 
-        { {0,1,0,0}, {0,1,0,0}, {0,1,0,0}, {0,1,0,0} }  
-    },
-    // J shape 
-    {
-        { {1,0,0,0}, {1,1,1,0}, {0,0,0,0}, {0,0,0,0} },
-        { {0,1,1,0}, {0,1,0,0}, {0,1,0,0}, {0,0,0,0} },
-        { {0,0,0,0}, {1,1,1,0}, {0,0,1,0}, {0,0,0,0} },
-        { {0,1,0,0}, {0,1,0,0}, {1,1,0,0}, {0,0,0,0} }
-    },
-    // L shape 
-    {
-        { {0,0,1,0}, {1,1,1,0}, {0,0,0,0}, {0,0,0,0} },
-        { {0,1,0,0}, {0,1,0,0}, {0,1,1,0}, {0,0,0,0} },
-        { {0,0,0,0}, {1,1,1,0}, {1,0,0,0}, {0,0,0,0} },
-        { {1,1,0,0}, {0,1,0,0}, {0,1,0,0}, {0,0,0,0} }
-    },
-    // O shape (square)
-    {
-        { {1,1,0,0}, {1,1,0,0}, {0,0,0,0}, {0,0,0,0} },
-        { {1,1,0,0}, {1,1,0,0}, {0,0,0,0}, {0,0,0,0} },
-        { {1,1,0,0}, {1,1,0,0}, {0,0,0,0}, {0,0,0,0} },
-        { {1,1,0,0}, {1,1,0,0}, {0,0,0,0}, {0,0,0,0} }
-    },
-    // S shape 
-    {
-        { {0,1,1,0}, {1,1,0,0}, {0,0,0,0}, {0,0,0,0} },
-        { {0,1,0,0}, {0,1,1,0}, {0,0,1,0}, {0,0,0,0} },
-        { {0,0,0,0}, {0,1,1,0}, {1,1,0,0}, {0,0,0,0} },
-        { {1,0,0,0}, {1,1,0,0}, {0,1,0,0}, {0,0,0,0} }
-    },
-    // T shape 
-    {
-        { {0,1,0,0}, {1,1,1,0}, {0,0,0,0}, {0,0,0,0} },
-        { {0,1,0,0}, {0,1,1,0}, {0,1,0,0}, {0,0,0,0} },
-        { {0,0,0,0}, {1,1,1,0}, {0,1,0,0}, {0,0,0,0} },
-        { {0,1,0,0}, {1,1,0,0}, {0,1,0,0}, {0,0,0,0} }
-    },
-    // Z shape 
-    {
-        { {1,1,0,0}, {0,1,1,0}, {0,0,0,0}, {0,0,0,0} },
-        { {0,0,1,0}, {0,1,1,0}, {0,1,0,0}, {0,0,0,0} },
-        { {0,0,0,0}, {1,1,0,0}, {0,1,1,0}, {0,0,0,0} },
-        { {0,1,0,0}, {1,1,0,0}, {1,0,0,0}, {0,0,0,0} }
-    }
-};
+const double PROCESS_START = now_seconds(); // For the startup timings printed once the assets are ready
+double firstFrameTime = 0; // When the loading frame was shown
+double imagesLoadedTime = 0; // When the images and cached text were ready
+GameTimer gameTimer; // Handles frame timing
+SimulationClock simClock; // Turns frame time into fixed simulation ticks
+Tetromino previousPiece; // The falling piece as it was before the last tick, for interpolated drawing
+InputProcessor input; // Timestamped key events and auto-shift
+SoundMixer mixer; // Starts sound effects, at most SOUND_VOICES per frame
+FrameProfiler profiler; // Per-phase frame timings and trace recording
+bool showProfiler = false; // Draw the profiler overlay in the sidebar (F3)
+string profilerLines[PHASE_COUNT]; // Overlay text, refreshed every PROFILER_REFRESH_FRAMES frames
+int profilerFrame = 0; // Frames since the overlay text was last refreshed
+const int PROFILER_REFRESH_FRAMES = 30;
+const int BOT_DEPTH = 1; // Pieces the autoplayer looks ahead past the current one
+const int BOT_TABLE_MB = 16; // Size of its transposition table, only built from depth 2 (at depth 1 no position is reached twice)
+unique_ptr<WorkStealingPool> botPool; // Threads the autoplayer searches on; created the first time autoplay is turned on
+unique_ptr<TranspositionTable> botTable; // Autoplayer's cache of lookahead values, or empty
+unique_ptr<AiPlayer> bot; // Picks placements when autoplay is on
+AllocFrameCheck allocCheck; // Fails the frame if it allocates (only with TETRIS_TRACK_ALLOCS)
+RollbackBuffer rollback; // The last ten seconds of ticks, for rewinding
+ReplayRecorder recorder; // Streams the current game to REPLAY_PATH (declared after session, so it is destroyed first)
+const char* const REPLAY_PATH = "last_replay.ttr";
+ScoreStore scores; // Every finished game, on disk and in a sorted index
+const char* const SCORE_LOG_PATH = "scores.log";
 
 // Color for each shape
 const color SHAPE_COLORS[7] = {COLOR_CYAN, COLOR_BLUE, COLOR_ORANGE, COLOR_YELLOW, COLOR_GREEN, COLOR_PURPLE, COLOR_RED};
 
-// GAME FUNCTIONS 
-// Checks if the given tetromino collides with the board or boundaries
-bool check_collision(const Tetromino& piece) 
+// Text on the HUD. It is rasterized once at startup (see HudText), so these strings are only read then
+const string HUD_FONT = "04B_30__.TTF";
+const string BUTTON_FONT = "Litebulb 8-bit.TTF";
+const string LABEL_SCORE = "SCORE";
+const string LABEL_LEVEL = "LEVEL";
+const string LABEL_HIGHEST = "HIGHEST";
+const string LABEL_SELECT_LEVEL = "SELECT LEVEL";
+const string LABEL_LOADING = "LOADING...";
+const string LABEL_PLAY = "PLAY";
+const string LABEL_RESTART = "RESTART";
+const string KEYBIND_LABELS[8] = {"KEYBINDS:", "Left Arrow : Left", "Right Arrow : Right", "Up Arrow : Rotate",
+                                  "Down Arrow : Soft Drop", "Space : Hard Drop", "Esc : Pause", "A : Autoplay"};
+const string LABEL_AUTOPLAY_ON = "A : Autoplay ON";
+const string LABEL_TIME = "TIME: ";
+const string LABEL_SECONDS = "s";
+
+// Struct for a piece of text rasterized once into its own bitmap
+struct TextSprite
 {
-    for (int ri = 0; ri < 4; ri++) 
+    bitmap bmp;
+    int width;
+
+    TextSprite() : bmp(nullptr), width(0) {}
+
+    // Function to render the text into a new bitmap with the given (unique) name
+    void initialize(const string& name, const string& text, const color& clr, const string& font, int size)
     {
-        for (int ci = 0; ci < 4; ci++) 
-        {
-            if (SHAPES[piece.shape][piece.rotation][ri][ci]) 
-            {
-                int bci = piece.pos.x + ci; // Board column index
-                int bri = piece.pos.y + ri; // Board row index
+        width = max(1, text_width(text, font, size));
+        bmp = create_bitmap(name, width, max(1, text_height(text, font, size)));
+        clear_bitmap(bmp, COLOR_TRANSPARENT);
+        draw_text_on_bitmap(bmp, text, clr, font, size, 0, 0);
+    }
 
-                // Check for out-of-bounds or overlap with filled cell
-                if (bci < 0 || bci >= GRID_WIDTH || bri >= GRID_HEIGHT || (bri >= 0 && board[bri][bci])) 
-                {
-                    return true;
-                }
-            }
-        }
+    // Function to draw the text with its top left at (x, y)
+    void draw(double x, double y) const
+    {
+        draw_bitmap(bmp, x, y);
     }
-    return false;
-}
+};
 
-// Function to load the highest score
-void load_highest_score() 
+// Struct for the glyphs 0-9 of one font, size and colour, rendered side by side into one bitmap
+struct DigitStrip
 {
-    json data = json_from_file("highscore.json");    
+    bitmap bmp;
+    int offsets[10]; // Left edge of each digit in the strip
+    int widths[10];
+    int height;
+
+    DigitStrip() : bmp(nullptr), height(0) {}
 
-    if (json_has_key(data, "highest_score")) 
+    // Function to render the ten digits
+    void initialize(const string& name, const color& clr, const string& font, int size)
     {
-        stats.highScore = json_read_number_as_int(data, "highest_score");  
+        string digit = "0";
+        int total = 0;
+        for (int d = 0; d < 10; d++)
+        {
+            digit[0] = static_cast<char>('0' + d);
+            offsets[d] = total;
+            widths[d] = text_width(digit, font, size);
+            height = max(height, text_height(digit, font, size));
+            total += widths[d];
+        }
+        bmp = create_bitmap(name, max(1, total), max(1, height));
+        clear_bitmap(bmp, COLOR_TRANSPARENT);
+        for (int d = 0; d < 10; d++)
+        {
+            digit[0] = static_cast<char>('0' + d);
+            draw_text_on_bitmap(bmp, digit, clr, font, size, offsets[d], 0);
+        }
     }
+};
 
-    free_json(data);
-}
+const int NUMBER_MAX_DIGITS = 10; // Enough for any int
 
-// Function to save the current highest score
-void save_highest_score() 
+// Struct for a number on the HUD. Its bitmap is recomposed from a digit strip only when the value changes,
+// so a steady frame draws it with one blit and no text rendering.
+struct NumberField
 {
-    json data = create_json();
-    json_set_number(data, "highest_score", stats.highScore);
-    json_to_file(data, "highscore.json");
-}
+    const DigitStrip* strip;
+    bitmap bmp;
+    int value; // Value currently in bmp
+    int width; // Width of the digits currently in bmp
+    bool valid; // False until the first value is composed
 
-// Function to spawn a new random tetromino at the top of the board
-void spawn_new_tetromino() 
-{
-    currentPiece = Tetromino(rand() % 7, 0, 3, 0);
+    NumberField() : strip(nullptr), bmp(nullptr), value(0), width(0), valid(false) {}
 
-    // If the new piece collides immediately, the game is over
-    if (check_collision(currentPiece)) 
+    // Function to create the field's bitmap, wide enough for the widest possible number
+    void initialize(const string& name, const DigitStrip& digits)
     {
-        state.endGame();
+        strip = &digits;
+        int widest = 0;
+        for (int d = 0; d < 10; d++)
+        {
+            widest = max(widest, digits.widths[d]);
+        }
+        bmp = create_bitmap(name, widest * NUMBER_MAX_DIGITS, max(1, digits.height));
+    }
 
-        // Update high score if needed
-        if (stats.score > stats.highScore) 
+    // Function to draw the value at (x, y), recomposing the bitmap first if the value changed
+    void draw(int newValue, double x, double y)
+    {
+        if (!valid || newValue != value)
         {
-            stats.highScore = stats.score;
-            save_highest_score();
+            compose(max(0, newValue));
         }
+        draw_bitmap(bmp, x, y);
     }
-}
 
-// Function to lock the current tetromino into the board (makes its cells permanent)
-void lock_tetromino() 
+private:
+    // Function to copy the value's digits out of the strip
+    void compose(int newValue)
+    {
+        int digits[NUMBER_MAX_DIGITS];
+        int count = 0;
+        int rest = newValue;
+        do
+        {
+            digits[count++] = rest % 10;
+            rest /= 10;
+        } while (rest > 0 && count < NUMBER_MAX_DIGITS);
+
+        clear_bitmap(bmp, COLOR_TRANSPARENT);
+        width = 0;
+        for (int i = count - 1; i >= 0; i--)
+        {
+            int d = digits[i];
+            draw_bitmap_on_bitmap(bmp, strip->bmp, width, 0, option_part_bmp(strip->offsets[d], 0, strip->widths[d], strip->height));
+            width += strip->widths[d];
+        }
+        value = newValue;
+        valid = true;
+    }
+};
+
+// Struct for every piece of sidebar text, rasterized at startup
+struct HudText
 {
-    for (int y = 0; y < 4; y++) 
+    DigitStrip yellowDigits; // Score, level and high score
+    DigitStrip whiteDigits; // Game time
+    NumberField score;
+    NumberField level;
+    NumberField seconds;
+    NumberField highScore;
+    TextSprite time;
+    TextSprite secondsSuffix;
+    TextSprite selectLevel;
+    TextSprite levelOptions[MAX_LEVEL];
+    TextSprite levelOptionsSelected[MAX_LEVEL];
+    TextSprite keybinds[8];
+    TextSprite autoplayOn;
+    TextSprite play;
+    TextSprite restart;
+
+    // Function to render all text (needs a window, since fonts load through SplashKit)
+    void initialize()
     {
-        for (int x = 0; x < 4; x++) 
+        char name[32];
+        yellowDigits.initialize("hud_digits_yellow", COLOR_YELLOW, HUD_FONT, 20);
+        whiteDigits.initialize("hud_digits_white", COLOR_WHITE, HUD_FONT, 20);
+        score.initialize("hud_score", yellowDigits);
+        level.initialize("hud_level", yellowDigits);
+        highScore.initialize("hud_high_score", yellowDigits);
+        seconds.initialize("hud_seconds", whiteDigits);
+        time.initialize("hud_time", LABEL_TIME, COLOR_WHITE, HUD_FONT, 20);
+        secondsSuffix.initialize("hud_seconds_suffix", LABEL_SECONDS, COLOR_WHITE, HUD_FONT, 20);
+        selectLevel.initialize("hud_select_level", LABEL_SELECT_LEVEL, COLOR_WHITE, HUD_FONT, 15);
+        for (int i = 0; i < MAX_LEVEL; i++)
         {
-            if (SHAPES[currentPiece.shape][currentPiece.rotation][y][x]) 
-            {
-                int nx = currentPiece.pos.x + x;
-                int ny = currentPiece.pos.y + y;
-                // Only lock cells within the visible board
-                if (ny >= 0) board[ny][nx] = currentPiece.shape + 1;
-            }
+            string label = "Level " + to_string(i + 1);
+            snprintf(name, sizeof(name), "hud_level_%d", i + 1);
+            levelOptions[i].initialize(name, label, COLOR_WHITE, HUD_FONT, 15);
+            snprintf(name, sizeof(name), "hud_level_%d_selected", i + 1);
+            levelOptionsSelected[i].initialize(name, label, COLOR_CYAN, HUD_FONT, 15);
+        }
+        keybinds[0].initialize("hud_keybinds_0", KEYBIND_LABELS[0], COLOR_WHITE, HUD_FONT, 8);
+        for (int i = 1; i < 8; i++)
+        {
+            snprintf(name, sizeof(name), "hud_keybinds_%d", i);
+            keybinds[i].initialize(name, KEYBIND_LABELS[i], COLOR_YELLOW, HUD_FONT, 10);
         }
+        autoplayOn.initialize("hud_autoplay_on", LABEL_AUTOPLAY_ON, COLOR_YELLOW, HUD_FONT, 10);
+        play.initialize("hud_play", LABEL_PLAY, COLOR_WHITE, BUTTON_FONT, 50);
+        restart.initialize("hud_restart", LABEL_RESTART, COLOR_WHITE, BUTTON_FONT, 50);
     }
-}
+};
 
-// Function to check for and clears any full lines, updates score and level
-void clear_lines() 
+HudText hud; // Pre-rendered sidebar text
+
+const int ATLAS_GHOST = 7; // Atlas index of the first ghost outline (one per shape, after the seven filled cells)
+const int ATLAS_EMPTY = 14; // Atlas index of the empty cell outline
+const int ATLAS_CELLS = 15; // Sprites in the atlas
+
+// Struct for a sprite sheet of every cell the game draws: the seven filled
+// cells, the seven ghost outlines and the empty grid outline, side by side in
+// one bitmap. Every cell is drawn as a part-blit of this one texture, so the
+// graphics backend never switches textures or builds a primitive per cell.
+struct CellAtlas
 {
-    int lines = 0; // Number of lines cleared this call
-    
-    // Loop from bottom row to top
-    for (int y = GRID_HEIGHT - 1; y >= 0; y--) 
+    bitmap sheet;
+
+    CellAtlas() : sheet(nullptr) {}
+
+    // Function to render every sprite once into the sheet
+    void initialize()
+    {
+        sheet = create_bitmap("cell_atlas", ATLAS_CELLS * CELL_SIZE, CELL_SIZE);
+        clear_bitmap(sheet, COLOR_TRANSPARENT);
+        for (int i = 0; i < 7; i++)
+        {
+            fill_rectangle_on_bitmap(sheet, SHAPE_COLORS[i], i * CELL_SIZE, 0, CELL_SIZE - 1, CELL_SIZE - 1);
+            draw_rectangle_on_bitmap(sheet, SHAPE_COLORS[i], (ATLAS_GHOST + i) * CELL_SIZE, 0, CELL_SIZE - 1, CELL_SIZE - 1);
+        }
+        draw_rectangle_on_bitmap(sheet, COLOR_GRAY, ATLAS_EMPTY * CELL_SIZE, 0, CELL_SIZE, CELL_SIZE);
+    }
+
+    // Function to get the drawing options that select one sprite
+    drawing_options part(int index) const
     {
-        bool full = true;
+        return option_part_bmp(index * CELL_SIZE, 0, CELL_SIZE, CELL_SIZE);
+    }
+
+    // Function to draw a sprite to the window at grid cell (x, y)
+    void draw(int index, int x, int y) const
+    {
+        draw_bitmap(sheet, x * CELL_SIZE, y * CELL_SIZE, part(index));
+    }
+
+    // Function to draw a sprite to the window at a pixel position
+    void drawAt(int index, double px, double py) const
+    {
+        draw_bitmap(sheet, px, py, part(index));
+    }
+
+    // Function to draw a sprite onto a bitmap at grid cell (x, y)
+    void drawOn(bitmap dest, int index, int x, int y) const
+    {
+        draw_bitmap_on_bitmap(dest, sheet, x * CELL_SIZE, y * CELL_SIZE, part(index));
+    }
+};
 
-        // Check if row is full
-        for (int x = 0; x < GRID_WIDTH; x++) 
+CellAtlas atlas; // Sprites for every kind of cell
+
+// Struct for the offscreen layers each frame is built from. The static layer
+// never changes after startup; the board layer only redraws cells whose colour
+// changed since the last frame; the falling piece, ghost and changing text are
+// drawn on top every frame.
+struct RenderLayers
+{
+    bitmap staticLayer; // Background, overlay, empty grid, sidebar and fixed labels (whole window)
+    bitmap boardLayer; // The grid area with locked cells drawn over it
+    uint8_t shownColors[GRID_HEIGHT][GRID_WIDTH]; // Cell colours the board layer currently shows
+    int redrawnCells; // Cells redrawn by the last update (0 on most frames)
+
+    RenderLayers() : staticLayer(nullptr), boardLayer(nullptr), redrawnCells(0) {}
+
+    // Function to compose the static layer and start the board layer empty (needs the assets and atlas loaded)
+    void initialize(const Assets& assets)
+    {
+        staticLayer = create_bitmap("static_layer", WINDOW_WIDTH, WINDOW_HEIGHT);
+        clear_bitmap(staticLayer, COLOR_BLACK);
+        draw_bitmap_on_bitmap(staticLayer, assets.background, 0, 0);
+        // Semi-transparent overlay for contrast
+        fill_rectangle_on_bitmap(staticLayer, rgba_color(0, 0, 0, 204), 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+        // Empty cell outlines
+        for (int y = 0; y < GRID_HEIGHT; y++)
         {
-            if (board[y][x] == 0) 
+            for (int x = 0; x < GRID_WIDTH; x++)
             {
-                full = false;
-                break;
+                atlas.drawOn(staticLayer, ATLAS_EMPTY, x, y);
             }
         }
-        if (full) 
-        {
-            lines++;
+        // Sidebar background and the labels that never change
+        fill_rectangle_on_bitmap(staticLayer, rgba_color(64, 64, 64, 102), SCREEN_WIDTH, 0, SIDEBAR_WIDTH, SCREEN_HEIGHT);
+        draw_text_on_bitmap(staticLayer, LABEL_SCORE, COLOR_WHITE, HUD_FONT, 30, SCREEN_WIDTH + 10, 20);
+        draw_text_on_bitmap(staticLayer, LABEL_LEVEL, COLOR_WHITE, HUD_FONT, 30, SCREEN_WIDTH + 10, 80);
+        draw_text_on_bitmap(staticLayer, LABEL_HIGHEST, COLOR_WHITE, HUD_FONT, 30, SCREEN_WIDTH + 10, 500);
+
+        // The board layer starts as a copy of the empty grid
+        boardLayer = create_bitmap("board_layer", SCREEN_WIDTH, SCREEN_HEIGHT);
+        draw_bitmap_on_bitmap(boardLayer, staticLayer, 0, 0, option_part_bmp(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT));
+        memset(shownColors, 0, sizeof(shownColors));
+    }
 
-            // Move all rows above down by one
-            for (int ty = y; ty > 0; ty--) 
+    // Function to redraw the board layer's cells that differ from the board
+    void updateBoard(const Board& board)
+    {
+        redrawnCells = 0;
+        if (memcmp(shownColors, board.colors, sizeof(shownColors)) == 0)
+        {
+            return;
+        }
+        for (int y = 0; y < GRID_HEIGHT; y++)
+        {
+            for (int x = 0; x < GRID_WIDTH; x++)
             {
-                board[ty] = board[ty - 1];
+                uint8_t c = board.colors[y][x];
+                if (c == shownColors[y][x])
+                {
+                    continue;
+                }
+                // Put back the empty cell from the static layer, then fill it if needed
+                int px = x * CELL_SIZE;
+                int py = y * CELL_SIZE;
+                draw_bitmap_on_bitmap(boardLayer, staticLayer, px, py, option_part_bmp(px, py, CELL_SIZE, CELL_SIZE));
+                if (c)
+                {
+                    atlas.drawOn(boardLayer, c - 1, x, y);
+                }
+                shownColors[y][x] = c;
+                redrawnCells++;
             }
-            // Clear the top row (now empty)
-            board[0] = vector<int>(GRID_WIDTH, 0);
-
-            y++; // Recheck this row (since it now has new content)
         }
     }
-    if (lines > 0) 
+
+    // Function to draw both layers to the window
+    void draw() const
     {
-        play_sound_effect(assets.clear_line_sfx);
-        stats.linesCleared += lines;
-        stats.score += lines * 100 * stats.level;
-        // Level up every 5 lines, up to MAX_LEVEL
-        stats.level = min(MAX_LEVEL, state.selectedLevel + stats.linesCleared / 5);
+        draw_bitmap(staticLayer, 0, 0);
+        draw_bitmap(boardLayer, 0, 0);
     }
+};
+
+RenderLayers layers; // Cached background and board images
+
+// GAME FUNCTIONS 
+// Function to carry the high score from the old highscore.json over into a new, empty score log
+void import_legacy_high_score()
+{
+    json data = json_from_file("highscore.json");
+
+    if (json_has_key(data, "highest_score"))
+    {
+        ScoreRecord r = {};
+        r.score = json_read_number_as_int(data, "highest_score");
+        r.level = 1;
+        r.startLevel = 1;
+        r.time = static_cast<int64_t>(time(NULL));
+        scores.add(r);
+    }
+
+    free_json(data);
 }
 
-// Function to draw the current state of the board
-void draw_grid() 
+// Function to pick up the score log once the background load has finished (replaces reading highscore.json)
+void poll_scores()
+{
+    if (!scores.poll())
+    {
+        return;
+    }
+    allocCheck.excuse();
+    if (scores.count() == 0)
+    {
+        import_legacy_high_score();
+    }
+    session.highScore = max(session.highScore, scores.best());
+}
+
+// Function to log a finished game; the write happens on the score log's own thread
+void save_score()
 {
-    for (int y = 0; y < GRID_HEIGHT; y++) 
+    // Only happens at game over, and the index may grow, so this frame may allocate
+    allocCheck.excuse();
+    ScoreRecord r = {};
+    r.score = session.stats.score;
+    r.level = static_cast<int16_t>(session.stats.level);
+    r.startLevel = static_cast<int16_t>(session.startLevel);
+    r.lines = session.stats.linesCleared;
+    r.seed = session.randomizer.seed;
+    r.time = static_cast<int64_t>(time(NULL));
+    scores.add(r);
+    if (scores.ready())
     {
-        for (int x = 0; x < GRID_WIDTH; x++) 
+        printf("game over: %d points, rank %lld of %lld\n", r.score, scores.rank(r.score), scores.count());
+    }
+}
+
+// Function to react to events reported by the game session (sounds, game over)
+void handle_events(int events)
+{
+    if (events & EVENT_LINES_CLEARED)
+    {
+        mixer.trigger(assets.clear_line_sfx);
+    }
+
+    // If the new piece collided immediately, the game is over
+    if (events & EVENT_GAME_OVER)
+    {
+        state.endGame();
+        recorder.end();
+
+        // Log the game and update the high score if needed
+        save_score();
+        if (session.stats.score > session.highScore)
         {
-            if (board[y][x]) 
-            {
-                // Filled cell: draw colored rectangle
-                fill_rectangle(SHAPE_COLORS[board[y][x] - 1], x * CELL_SIZE, y * CELL_SIZE, CELL_SIZE - 1, CELL_SIZE - 1);
-            } 
-            else 
-            {
-                // Empty cell: draw gray outline
-                draw_rectangle(COLOR_GRAY, x * CELL_SIZE, y * CELL_SIZE, CELL_SIZE, CELL_SIZE);
-            }
+            session.highScore = session.stats.score;
         }
     }
 }
 
+// Function to draw the current state of the board (only cells that changed are redrawn into the board layer)
+void draw_grid() 
+{
+    layers.updateBoard(session.board);
+    layers.draw();
+}
+
 // Function to draw the current falling tetromino
 void draw_tetromino() 
 {
@@ -372,15 +719,22 @@ void draw_tetromino()
     {
         return;
     }
-    for (int y = 0; y < 4; y++) 
+    const Tetromino& piece = session.currentPiece;
+
+    // If the last tick dropped the piece one row, slide it between the two rows; any other change snaps
+    double offsetY = 0;
+    if (piece.shape == previousPiece.shape && piece.rotation == previousPiece.rotation && piece.pos.x == previousPiece.pos.x
+        && piece.pos.y == previousPiece.pos.y + 1)
     {
-        for (int x = 0; x < 4; x++) 
-        {
-            if (SHAPES[currentPiece.shape][currentPiece.rotation][y][x]) 
-            {
-                fill_rectangle(SHAPE_COLORS[currentPiece.shape], (currentPiece.pos.x + x) * CELL_SIZE, (currentPiece.pos.y + y) * CELL_SIZE, CELL_SIZE - 1, CELL_SIZE - 1);
-            }
-        }
+        offsetY = (simClock.alpha() - 1.0) * CELL_SIZE;
+    }
+
+    const ShapeInfo& shape = shape_info(piece.shape, piece.rotation);
+    for (int i = 0; i < 4; i++) 
+    {
+        int x = piece.pos.x + shape.cells[i].x;
+        int y = piece.pos.y + shape.cells[i].y;
+        atlas.drawAt(piece.shape, x * CELL_SIZE, y * CELL_SIZE + offsetY);
     }
 }
 
@@ -392,75 +746,53 @@ void draw_ghost()
         return;
     }
 
-    // Copy the current piece and move it down until it would collide
-    Tetromino ghost = currentPiece;
-    while (!check_collision(Tetromino(ghost.shape, ghost.rotation, ghost.pos.x, ghost.pos.y + 1))) 
-    {
-        ghost.pos.y++;
-    }
+    // Copy the current piece and put it on its landing row (cached by the session)
+    Tetromino ghost = session.currentPiece;
+    ghost.pos.y = session.ghostY();
 
     // Draw the ghost as an outline at its landing position
-    for (int y = 0; y < 4; y++) 
+    const ShapeInfo& shape = shape_info(ghost.shape, ghost.rotation);
+    for (int i = 0; i < 4; i++) 
     {
-        for (int x = 0; x < 4; x++) 
-        {
-            if (SHAPES[ghost.shape][ghost.rotation][y][x]) 
-            {
-                draw_rectangle(SHAPE_COLORS[ghost.shape], (ghost.pos.x + x) * CELL_SIZE, (ghost.pos.y + y) * CELL_SIZE, CELL_SIZE - 1, CELL_SIZE - 1);
-            }
-        }
+        int x = ghost.pos.x + shape.cells[i].x;
+        int y = ghost.pos.y + shape.cells[i].y;
+        atlas.draw(ATLAS_GHOST + ghost.shape, x, y);
     }
 }
 
 // Function to draw the entire game
 void draw_game()
 {
-    // Draw background
-    draw_bitmap(assets.background, 0, 0);
-    // Draw a semi-transparent overlay for contrast
-    fill_rectangle(rgba_color(0, 0, 0, 204), 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
-
-    // Draw the grid
+    // Draw background, overlay, sidebar, fixed labels and the grid from the cached layers
     draw_grid();
 
-    // Draw logo
+    // Draw logo (scaled when it was loaded)
     if (!state.gameStarted)
     {
-        int orig_w = bitmap_width(assets.logo);
-        int orig_h = bitmap_height(assets.logo);
-        double scale = 0.40;
-        int tgt_w = static_cast<int>(orig_w * scale);
-        int tgt_h = static_cast<int>(orig_h * scale);
-        int x = (SCREEN_WIDTH - tgt_w) / 2 - 228;
-        int y = 20;
-        drawing_options opts = option_scale_bmp(scale, scale);
-        draw_bitmap(assets.logo, x, y, opts);
+        draw_bitmap(assets.logo, assets.logoX, assets.logoY);
     }
 
     // Draw ghost piece and current falling piece
     draw_ghost();
     draw_tetromino();
 
-    // Draw sidebar background
-    fill_rectangle(rgba_color(64, 64, 64, 102), SCREEN_WIDTH, 0, SIDEBAR_WIDTH, SCREEN_HEIGHT);
+    // Draw score, level, and time (their labels are in the static layer)
+    hud.score.draw(session.stats.score, SCREEN_WIDTH + 10, 50);
+    hud.level.draw(session.stats.level, SCREEN_WIDTH + 10, 110);
 
-    // Draw score, level, and time
-    draw_text("SCORE", COLOR_WHITE, "04B_30__.TTF", 30, SCREEN_WIDTH + 10, 20);
-    draw_text(to_string(stats.score), COLOR_YELLOW, "04B_30__.TTF", 20, SCREEN_WIDTH + 10, 50);
-    draw_text("LEVEL", COLOR_WHITE, "04B_30__.TTF", 30, SCREEN_WIDTH + 10, 80);
-    draw_text(to_string(stats.level), COLOR_YELLOW, "04B_30__.TTF", 20, SCREEN_WIDTH + 10, 110);
-
-    int seconds = static_cast<int>(stats.gameTime / 1000.0);
-    draw_text("TIME: " + to_string(seconds) + "s", COLOR_WHITE, "04B_30__.TTF", 20, SCREEN_WIDTH + 10, 140);
+    int seconds = static_cast<int>(session.stats.gameTime / 1000.0);
+    hud.time.draw(SCREEN_WIDTH + 10, 140);
+    hud.seconds.draw(seconds, SCREEN_WIDTH + 10 + hud.time.width, 140);
+    hud.secondsSuffix.draw(SCREEN_WIDTH + 10 + hud.time.width + hud.seconds.width, 140);
 
     // Draw level select menu
     if (state.showLevelSelect) 
     {
-        draw_text("SELECT LEVEL", COLOR_WHITE, "04B_30__.TTF", 15, SCREEN_WIDTH + 10, 170);
+        hud.selectLevel.draw(SCREEN_WIDTH + 10, 170);
         for (int i = 1; i <= MAX_LEVEL; i++) 
         {
-            color c = (i == state.selectedLevel) ? COLOR_CYAN : COLOR_WHITE;
-            draw_text("Level " + to_string(i), c, "04B_30__.TTF", 15, SCREEN_WIDTH + 30, 170 + i * 20);
+            const TextSprite& option = (i == state.selectedLevel) ? hud.levelOptionsSelected[i - 1] : hud.levelOptions[i - 1];
+            option.draw(SCREEN_WIDTH + 30, 170 + i * 20);
         }
     }
 
@@ -470,27 +802,18 @@ void draw_game()
         const int kb_x = SCREEN_WIDTH + 10;
         int kb_y = 200;               
         const int line_h = 20;
-        const string font = "04B_30__.TTF";
-        const int size = 10;
-
-        draw_text("KEYBINDS:", COLOR_WHITE, font, 8, kb_x, kb_y);
-        kb_y += line_h;
-        draw_text("Left Arrow : Left", COLOR_YELLOW, font, size, kb_x, kb_y);
-        kb_y += line_h;
-        draw_text("Right Arrow : Right", COLOR_YELLOW, font, size, kb_x, kb_y);
-        kb_y += line_h;
-        draw_text("Up Arrow : Rotate", COLOR_YELLOW, font, size, kb_x, kb_y);
-        kb_y += line_h;
-        draw_text("Down Arrow : Soft Drop", COLOR_YELLOW, font, size, kb_x, kb_y);
-        kb_y += line_h;
-        draw_text("Space : Hard Drop", COLOR_YELLOW, font, size, kb_x, kb_y);
-        kb_y += line_h;
-        draw_text("Esc : Pause", COLOR_YELLOW, font, size, kb_x, kb_y);
+
+        hud.keybinds[0].draw(kb_x, kb_y);
+        for (int i = 1; i < 8; i++)
+        {
+            kb_y += line_h;
+            const TextSprite& label = (i == 7 && state.autoPlay) ? hud.autoplayOn : hud.keybinds[i];
+            label.draw(kb_x, kb_y);
+        }
     }
 
     // Draw highest score
-    draw_text("HIGHEST", COLOR_WHITE, "04B_30__.TTF", 30, SCREEN_WIDTH + 10, 500);
-    draw_text(to_string(stats.highScore), COLOR_YELLOW, "04B_30__.TTF", 20, SCREEN_WIDTH + 10, 530);
+    hud.highScore.draw(session.highScore, SCREEN_WIDTH + 10, 530);
 }
 
 // Function to draw the PLAY and RESTART buttons
@@ -498,65 +821,54 @@ void draw_buttons()
 {
     if (!state.gameStarted) 
     {
-        // PLAY button
-        fill_rectangle(COLOR_GREEN, SCREEN_WIDTH + 20, 300, 120, 40);
-        draw_text("PLAY", COLOR_WHITE, "Litebulb 8-bit.TTF", 50, SCREEN_WIDTH + 55, 300);
+        // PLAY button, grey until the audio has loaded
+        fill_rectangle(assets.ready ? COLOR_GREEN : COLOR_GRAY, SCREEN_WIDTH + 20, 300, 120, 40);
+        hud.play.draw(SCREEN_WIDTH + 55, 300);
     } 
     else if (state.gamePaused || state.gameOver) 
     {
         // RESTART button
         fill_rectangle(COLOR_RED, SCREEN_WIDTH + 20, 360, 120, 40);
-        draw_text("RESTART", COLOR_WHITE, "Litebulb 8-bit.TTF", 50, SCREEN_WIDTH + 30, 360);
+        hud.restart.draw(SCREEN_WIDTH + 30, 360);
     }
 }
 
 // Function to reset the game state for a new game
 void reset_game() 
 {
-    // Clear the board
-    board = vector<vector<int>>(GRID_HEIGHT, vector<int>(GRID_WIDTH, 0));
-    stats.reset(state.selectedLevel);
+    // Start a fresh session with a new random seed, and record it (opening the file may allocate)
+    recorder.end();
+    uint32_t seed = static_cast<uint32_t>(time(NULL)) ^ current_ticks();
+    session.randomizer.kind = PIECE_RANDOMIZER;
+    session.reset(state.selectedLevel, seed);
+    rollback.clear();
+    allocCheck.excuse();
+    recorder.begin(REPLAY_PATH, session, seed, state.selectedLevel);
     state.startTime = current_ticks();
-    spawn_new_tetromino();
     gameTimer.reset();
-}
-
-// Calculates the drop delay (speed) based on level and score
-int get_drop_delay()
-{
-    // Set a base delay: higher levels start faster
-    int base_delay = 70 - (stats.level - 1) * 8;
-
-    // Increase drop speed based on score milestones
-    int milestones = min(stats.score / 1000, 4);
-
-    // Each milestone reduces the delay by 4 ticks
-    int bonus_speed = milestones * 4;
-
-    // Pieces will never drop faster than every 20 ticks.
-    const int MAX_DROP = 20;
-
-    // Calculate the final delay, applying milestone bonuses and enforcing the minimum.
-    int final_delay = base_delay - bonus_speed;
-    return max(final_delay, MAX_DROP);
+    simClock.reset();
+    input.releaseAll();
+    previousPiece = session.currentPiece;
 }
 
 // Function to handle mouse clicks on the PLAY and RESTART buttons
 void button_clicks(point_2d mouse) 
 {
-    // PLAY button
-    if (!state.gameStarted && mouse.x > SCREEN_WIDTH + 20 && mouse.x < SCREEN_WIDTH + 140 && mouse.y > 300 && mouse.y < 340) 
+    // PLAY button (waits for the assets)
+    if (!state.gameStarted && assets.ready && mouse.x > SCREEN_WIDTH + 20 && mouse.x < SCREEN_WIDTH + 140 && mouse.y > 300 && mouse.y < 340) 
     {
-        play_sound_effect(assets.click_sfx);
+        mixer.trigger(assets.click_sfx);
         state.startGame();
-        play_music(assets.bgm, -1);
+        assets.fading_out = false;
+        set_music_volume(1.0); // The mixer ramps from silence, whatever volume the last fade-out left
+        fade_music_in(assets.bgm, -1, MUSIC_FADE_MS);
         reset_game();
     }
 
     // RESTART button: Only show if the game is paused
     if ((state.gamePaused) && mouse.x > SCREEN_WIDTH + 20 && mouse.x < SCREEN_WIDTH + 140 && mouse.y > 360 && mouse.y < 400) 
     {
-        play_sound_effect(assets.click_sfx);
+        mixer.trigger(assets.click_sfx);
         state.gameOver = false;
         state.gamePaused = false;
         state.gameStarted = false;
@@ -584,44 +896,95 @@ void level_selection(point_2d mouse)
     }
 }
 
-// Function to handle keyboard input for gameplay (movement, rotation, hard drop)
-void gameplay_input() 
+// Function to map a SplashKit key code to a game key; returns INPUT_KEY_COUNT for keys the game ignores
+InputKey input_key(int code)
 {
-    // Move left if left arrow is pressed and no collision
-    if (key_typed(LEFT_KEY) && !check_collision(Tetromino(currentPiece.shape, currentPiece.rotation, currentPiece.pos.x - 1, currentPiece.pos.y)))
+    switch (code)
     {
-        currentPiece.pos.x--;
+        case LEFT_KEY:
+            return INPUT_LEFT;
+        case RIGHT_KEY:
+            return INPUT_RIGHT;
+        case UP_KEY:
+            return INPUT_ROTATE;
+        case DOWN_KEY:
+            return INPUT_SOFT_DROP;
+        case SPACE_KEY:
+            return INPUT_HARD_DROP;
+        default:
+            return INPUT_KEY_COUNT;
     }
-    
-    // Move right if right arrow is pressed and no collision
-    if (key_typed(RIGHT_KEY) && !check_collision(Tetromino(currentPiece.shape, currentPiece.rotation, currentPiece.pos.x + 1, currentPiece.pos.y))) 
+}
+
+// Function called by SplashKit (inside process_events) when a key goes down; queues it with its time
+void on_key_down(int code)
+{
+    InputKey key = input_key(code);
+    if (key != INPUT_KEY_COUNT)
     {
-        currentPiece.pos.x++;
+        input.push(key, true, now_seconds());
     }
-    
-    // Rotate if up arrow is pressed and no collision after rotation
-    if (key_typed(UP_KEY)) 
+}
+
+// Function called by SplashKit (inside process_events) when a key goes up
+void on_key_up(int code)
+{
+    InputKey key = input_key(code);
+    if (key != INPUT_KEY_COUNT)
     {
-        int newRot = (currentPiece.rotation + 1) % 4;
-        if (!check_collision(Tetromino(currentPiece.shape, newRot, currentPiece.pos.x, currentPiece.pos.y))) 
-        {
-            currentPiece.rotation = newRot;
-        }
+        input.push(key, false, now_seconds());
     }
-    
-    // Hard drop (spacebar): move piece down until it collides, then lock it
-    if (key_typed(SPACE_KEY)) 
+}
+
+// Function to apply queued key presses and auto-shift (movement, rotation, hard drop) that happened up to `until`
+void gameplay_input(double until) 
+{
+    if (!state.gameStarted || state.gamePaused || state.gameOver) 
     {
-        while (!check_collision(Tetromino(currentPiece.shape, currentPiece.rotation, currentPiece.pos.x, currentPiece.pos.y + 1))) 
+        return;
+    }
+
+    // While autoplay is on, keys still update what is held but do not move the piece
+    handle_events(input.applyUntil(session, until, !state.autoPlay));
+}
+
+// Function to rewind the game by REWIND_TICKS (Backspace)
+void rewind_input()
+{
+    if (key_typed(BACKSPACE_KEY))
+    {
+        rollback.rewind(REWIND_TICKS);
+        previousPiece = session.currentPiece;
+    }
+}
+
+// Function to toggle autoplay (A key)
+void autoplay_input()
+{
+    if (key_typed(A_KEY))
+    {
+        state.autoPlay = !state.autoPlay;
+
+        // Start the search threads only once someone actually uses autoplay
+        if (state.autoPlay && !bot)
         {
-            currentPiece.pos.y++;
+            allocCheck.excuse();
+            botPool.reset(new WorkStealingPool());
+            if (BOT_DEPTH >= 2)
+            {
+                botTable.reset(new TranspositionTable(BOT_TABLE_MB));
+            }
+            bot.reset(new AiPlayer(botPool.get(), 8, 2000, BOT_DEPTH, botTable.get()));
         }
-        lock_tetromino();
-        clear_lines();
-        spawn_new_tetromino();
     }
 }
 
+// Function to let the AI place the current piece instead of the keyboard (autoplay mode)
+void bot_input()
+{
+    handle_events(bot->playPiece(session));
+}
+
 // Function to handle pause/unpause input (ESC key)
 void pause_input() 
 {
@@ -648,7 +1011,7 @@ void update_game_state()
     }
 
     // Update game timer
-    stats.gameTime += current_ticks() - state.startTime;
+    session.stats.gameTime += current_ticks() - state.startTime;
     state.startTime = current_ticks();
 }
 
@@ -661,77 +1024,136 @@ void update_timers()
         return;
     }
 
-    // If the down arrow key is held, soft drop the piece every 5 ticks
-    if (key_down(DOWN_KEY) && gameTimer.dropTimer % 5 == 0) 
+    // Soft drop while the down arrow is held, then apply gravity
+    handle_events(session.tick(input.softDropHeld()));
+}
+
+// Function to run one fixed simulation tick: the autoplayer's move (if on), then gravity
+void simulation_step()
+{
+    if (!state.gameStarted || state.gamePaused || state.gameOver) 
     {
-        // Check if moving down by 1 would cause a collision
-        if (!check_collision(Tetromino(currentPiece.shape, currentPiece.rotation, currentPiece.pos.x, currentPiece.pos.y + 1))) 
-        {
-            currentPiece.pos.y++;
-        }
+        return;
     }
-    
-    // Increment the drop timer every frame
-    gameTimer.dropTimer++;
 
-    // If the drop timer reaches the current drop delay threshold (based on level/score)
-    if (gameTimer.dropTimer >= get_drop_delay()) 
+    previousPiece = session.currentPiece;
+    if (state.autoPlay)
     {
-        gameTimer.dropTimer = 0;
+        bot_input(); // Let the AI place the piece
+    }
+    update_timers(); // Handle piece dropping
+}
 
-        // Try to move the piece down by one row
-        if (!check_collision(Tetromino(currentPiece.shape, currentPiece.rotation, currentPiece.pos.x, currentPiece.pos.y + 1))) 
-        {
-            currentPiece.pos.y++;
-        } 
-        else 
-        {
-            lock_tetromino();
-            clear_lines();
-            spawn_new_tetromino();
-        }
+// Function to start the music fade-out when the game ends
+void music_fade()
+{
+    // The fade itself runs in the audio mixer, per sample, so it needs nothing per frame
+    if (!assets.fading_out && state.gameOver && music_playing())
+    {
+        assets.fading_out = true;
+        fade_music_out(MUSIC_FADE_MS);
     }
 }
 
-// Function to handle music fade-in and fade-out effects
-void music_fade(double dt) 
+// Function to show a first frame before anything has loaded (SplashKit's built-in font needs no files)
+void draw_loading_frame()
+{
+    clear_screen(COLOR_BLACK);
+    draw_text(LABEL_LOADING, COLOR_WHITE, WINDOW_WIDTH / 2 - 40, WINDOW_HEIGHT / 2);
+    refresh_screen();
+    firstFrameTime = now_seconds();
+}
+
+// Function to finish loading once the audio is in, and report how long startup took
+void poll_assets()
 {
-    // Fade-in
-    if (state.gameStarted && !state.gameOver && !assets.fading_out && assets.fade_volume < 1.0f) 
+    if (assets.poll())
     {
-        assets.fade_volume += static_cast<float>(dt / 2.0);
-        assets.fade_volume = min(assets.fade_volume, 1.0f);
-        set_music_volume(assets.fade_volume);
+        allocCheck.excuse();
+        printf("startup: first frame %.0f ms, images %.0f ms, audio %.0f ms\n", (firstFrameTime - PROCESS_START) * 1000.0,
+               (imagesLoadedTime - PROCESS_START) * 1000.0, (now_seconds() - PROCESS_START) * 1000.0);
     }
+}
 
-    // Start fade-out when game is over and music is playing
-    if (!assets.fading_out && state.gameOver && music_playing()) 
+// Function to initialize the game: window, images, audio, and highest score
+void initialize_game() 
+{
+    open_window("Tetris", WINDOW_WIDTH, WINDOW_HEIGHT); // Open game window
+    
+    register_callback_on_key_down(on_key_down); // Timestamp game keys as they arrive
+    register_callback_on_key_up(on_key_up);
+    assets.startAudio(); // Decode audio on a background thread while the rest loads
+    draw_loading_frame(); // Put something on screen before any file is read
+    assets.loadImages(); // Load images (main thread only)
+    hud.initialize(); // Rasterize the sidebar text once
+    atlas.initialize(); // Render the cell sprites
+    layers.initialize(assets); // Compose the static background and empty board
+    imagesLoadedTime = now_seconds();
+    scores.open(SCORE_LOG_PATH); // Load past scores on a background thread
+    rollback.attach(session); // Keep recent ticks for rewinding
+    for (int p = 0; p < PHASE_COUNT; p++)
     {
-        assets.fading_out = true;
+        profilerLines[p].reserve(64);
     }
+}
 
-    // Fade-out
-    if (assets.fading_out) 
+// Function to toggle the profiler overlay (F3) and start or stop recording a trace (F4)
+void profiler_input()
+{
+    if (key_typed(F3_KEY))
+    {
+        showProfiler = !showProfiler;
+        profilerFrame = PROFILER_REFRESH_FRAMES; // Fill in the text straight away
+    }
+    if (key_typed(F4_KEY))
     {
-        assets.fade_volume -= static_cast<float>(dt / 2.0);
-        if (assets.fade_volume <= 0.0f) 
+        if (profiler.tracing())
+        {
+            // Writing the file is a one-off, so this frame may allocate
+            allocCheck.excuse();
+            if (!profiler.stopTrace("trace.json"))
+            {
+                fprintf(stderr, "could not write trace.json\n");
+            }
+        }
+        else
         {
-            assets.fade_volume = 0.0f;
-            stop_music();
-            assets.fading_out = false;
+            profiler.startTrace();
         }
-        set_music_volume(assets.fade_volume);
     }
 }
 
-// Function to initialize the game: window, images, audio, and highest score
-void initialize_game() 
+// Function to draw per-phase p50/p99/max frame timings (in ms) in the sidebar
+void draw_profiler_overlay()
 {
-    srand(time(NULL)); // Seed random number generator
-    open_window("Tetris", WINDOW_WIDTH, WINDOW_HEIGHT); // Open game window
-    
-    assets.initialize(); // Load images and audio
-    load_highest_score(); // Load highest score from file
+    if (!showProfiler)
+    {
+        return;
+    }
+
+    // Percentiles only need to change a couple of times a second
+    if (++profilerFrame >= PROFILER_REFRESH_FRAMES)
+    {
+        profilerFrame = 0;
+        for (int p = 0; p < PHASE_COUNT; p++)
+        {
+            PhaseStats st = profiler.stats(static_cast<FramePhase>(p));
+            char line[64];
+            snprintf(line, sizeof(line), "%-8s %5.2f %5.2f %5.2f", PHASE_NAMES[p], st.p50Us / 1000.0f, st.p99Us / 1000.0f, st.maxUs / 1000.0f);
+            profilerLines[p].assign(line);
+        }
+    }
+
+    fill_rectangle(rgba_color(0, 0, 0, 180), SCREEN_WIDTH, 405, SIDEBAR_WIDTH, 12 * PHASE_COUNT + 6);
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        color c = (p == PHASE_FRAME) ? COLOR_WHITE : COLOR_CYAN;
+        draw_text(profilerLines[p], c, HUD_FONT, 7, SCREEN_WIDTH + 4, 408 + p * 12);
+    }
+    if (profiler.tracing())
+    {
+        fill_rectangle(COLOR_RED, WINDOW_WIDTH - 10, 408, 6, 6); // Recording marker
+    }
 }
 
 // MAIN FUNCTION 
@@ -741,38 +1163,110 @@ int main()
     
     while (!window_close_requested("Tetris")) 
     {
-        process_events(); // Handle window and input events
+        profiler.beginFrame();
+        {
+            ScopedPhase phase(profiler, PHASE_EVENTS);
+            process_events(); // Handle window and input events
+        }
         point_2d mouse = mouse_position(); // Get current mouse position
         
         double dt = gameTimer.getDeltaTime(); // Calculate time since last frame
+        bool running = state.gameStarted && !state.gamePaused && !state.gameOver;
 
-        // Handle mouse input for buttons and level selection
-        if (mouse_clicked(LEFT_BUTTON)) 
         {
-            button_clicks(mouse); // Handle PLAY/RESTART button clicks
-            level_selection(mouse); // Handle level selection clicks
+            ScopedPhase phase(profiler, PHASE_INPUT);
+            poll_assets(); // Finish loading once the audio thread is done
+            poll_scores(); // Take the high score from the score log once it has loaded
+            profiler_input(); // Handle profiler overlay and trace keys
+
+            // Handle mouse input for buttons and level selection
+            if (mouse_clicked(LEFT_BUTTON)) 
+            {
+                button_clicks(mouse); // Handle PLAY/RESTART button clicks
+                level_selection(mouse); // Handle level selection clicks
+            }
+            
+            // Handle keyboard/game state input
+            if (running) 
+            {
+                update_game_state(); // Update timer and state
+                pause_input(); // Handle pause input
+                autoplay_input(); // Handle autoplay toggle
+                rewind_input(); // Handle rewind
+            }
+            else if (state.gameStarted) 
+            {
+                pause_input(); // Allow pause/unpause even if paused/over
+                input.releaseAll(); // Keys pressed while paused are not replayed on resume
+            }
+            else
+            {
+                input.releaseAll();
+            }
         }
-        
-        // Handle keyboard/game state input
-        if (state.gameStarted && !state.gamePaused && !state.gameOver) 
+
+        if (running)
+        {
+            ScopedPhase phase(profiler, PHASE_SIMULATE);
+
+            // Run as many fixed ticks as the elapsed time covers, however fast frames are drawn.
+            // Key events go in between the ticks they happened between, and the newest ones right after.
+            double now = gameTimer.lastTime;
+            int ticks = simClock.advance(dt);
+            for (int i = 0; i < ticks; i++)
+            {
+                gameplay_input(simClock.tickTime(now, i, ticks)); // Handle movement/rotation/drop
+                simulation_step();
+            }
+            gameplay_input(now);
+        }
+
         {
-            update_game_state(); // Update timer and state
-            pause_input(); // Handle pause input
-            gameplay_input(); // Handle movement/rotation/drop
-            update_timers(); // Handle piece dropping
+            ScopedPhase phase(profiler, PHASE_AUDIO);
+            music_fade(); // Start the music fade-out at game over
+            mixer.endFrame(); // This frame's effects have started; free the voices
         }
-        else if (state.gameStarted) 
         {
-            pause_input(); // Allow pause/unpause even if paused/over
+            ScopedPhase phase(profiler, PHASE_DRAW);
+            draw_game(); // Draw the game scene
         }
-
-        // Handle music fade-in/fade-out
-        music_fade(dt);
-
-        draw_game();      // Draw the game scene
-        draw_buttons();   // Draw UI buttons
-        refresh_screen(60); // Refresh at 60 FPS
+        {
+            ScopedPhase phase(profiler, PHASE_BUTTONS);
+            draw_buttons(); // Draw UI buttons
+            draw_profiler_overlay(); // Draw frame timings if turned on
+        }
+        {
+            // Present the frame; uncapped by default, the simulation speed does not depend on it
+            ScopedPhase phase(profiler, PHASE_PRESENT);
+            if (RENDER_FPS_CAP > 0)
+            {
+                refresh_screen(RENDER_FPS_CAP);
+            }
+            else
+            {
+                refresh_screen();
+            }
+        }
+        input.frameShown(now_seconds()); // Record how long the presses drawn this frame took to appear
+        profiler.endFrame();
+        allocCheck.endFrame(); // Debug builds abort here if the frame allocated
     }
 
+    if (profiler.tracing())
+    {
+        profiler.stopTrace("trace.json");
+    }
+    printf("input latency p50 %.1f ms, p99 %.1f ms (%lld presses)\n", input.latency.percentileMs(50), input.latency.percentileMs(99),
+           input.latency.total);
+    printf("sound effects %lld played, %lld dropped over the voice limit\n", mixer.played, mixer.dropped);
+    scores.close(); // Wait for the last game to reach the disk
+    if (scores.error())
+    {
+        printf("could not use %s (unwritable, or not a score log of this version; it was left as it is)\n", SCORE_LOG_PATH);
+    }
+    else if (scores.corrupt > 0)
+    {
+        printf("skipped %lld damaged records in %s\n", scores.corrupt, SCORE_LOG_PATH);
+    }
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,216 @@
+// WORK-STEALING THREAD POOL //
+// A fixed set of worker threads that run parallelFor() jobs over an index
+// range. Each worker starts with its own slice of the range and takes indices
+// from the front; a worker that runs dry steals the back half of another
+// worker's slice. A slice is a single atomic word, so taking and stealing are
+// both one compare-and-swap and no locks are held while tasks run.
+
+#ifndef TETRIS_THREAD_POOL_H
+#define TETRIS_THREAD_POOL_H
+
+#include "atomic"
+#include "condition_variable"
+#include "cstdint"
+#include "mutex"
+#include "thread"
+#include "type_traits"
+#include "vector"
+
+// Struct for one worker's remaining slice of the index range, packed as (end << 32 | begin)
+struct alignas(64) WorkSlice
+{
+    std::atomic<uint64_t> range;
+
+    WorkSlice() : range(0) {}
+
+    static uint64_t pack(uint32_t begin, uint32_t end)
+    {
+        return (static_cast<uint64_t>(end) << 32) | begin;
+    }
+
+    // Function to take the next index from the front; returns -1 if the slice is empty
+    int64_t take()
+    {
+        uint64_t v = range.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            uint32_t begin = static_cast<uint32_t>(v);
+            uint32_t end = static_cast<uint32_t>(v >> 32);
+            if (begin >= end)
+            {
+                return -1;
+            }
+            if (range.compare_exchange_weak(v, pack(begin + 1, end), std::memory_order_acq_rel))
+            {
+                return begin;
+            }
+        }
+    }
+
+    // Function to steal the back half of the slice into [begin, end); returns false if there was nothing to steal
+    bool steal(uint32_t& stolenBegin, uint32_t& stolenEnd)
+    {
+        uint64_t v = range.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            uint32_t begin = static_cast<uint32_t>(v);
+            uint32_t end = static_cast<uint32_t>(v >> 32);
+            if (begin >= end)
+            {
+                return false;
+            }
+            uint32_t mid = begin + (end - begin) / 2;
+            if (range.compare_exchange_weak(v, pack(begin, mid), std::memory_order_acq_rel))
+            {
+                stolenBegin = mid;
+                stolenEnd = end;
+                return true;
+            }
+        }
+    }
+};
+
+// Struct for the pool itself
+struct WorkStealingPool
+{
+    // Creates a pool with the given number of threads (0 = one per hardware thread); the calling thread counts as one
+    explicit WorkStealingPool(int threads = 0)
+        : slices(resolveThreads(threads)), generation(0), finished(0), stopping(false), job(nullptr), jobContext(nullptr)
+    {
+        for (int i = 1; i < size(); i++)
+        {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : workers)
+        {
+            t.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Number of threads taking part in each job, including the caller
+    int size() const
+    {
+        return static_cast<int>(slices.size());
+    }
+
+    // Function to run fn(index, worker) for every index in [0, count) and wait for all of them to finish
+    template <typename Fn>
+    void parallelFor(int count, Fn&& fn)
+    {
+        if (count <= 0)
+        {
+            return;
+        }
+
+        // Split the range evenly, one slice per worker
+        int n = size();
+        for (int i = 0; i < n; i++)
+        {
+            uint32_t begin = static_cast<uint32_t>(static_cast<int64_t>(count) * i / n);
+            uint32_t end = static_cast<uint32_t>(static_cast<int64_t>(count) * (i + 1) / n);
+            slices[i].range.store(WorkSlice::pack(begin, end), std::memory_order_relaxed);
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            typedef typename std::remove_reference<Fn>::type Functor;
+            job = [](void* context, int index, int worker) { (*static_cast<Functor*>(context))(index, worker); };
+            jobContext = &fn;
+            finished.store(0, std::memory_order_relaxed);
+            generation++;
+        }
+        wake.notify_all();
+
+        // The caller works as worker 0, then waits for every other worker to check out of this job
+        runJob(0);
+        while (finished.load(std::memory_order_acquire) != n - 1)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    std::vector<WorkSlice> slices; // One slice per worker, index 0 is the calling thread
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable wake;
+    uint64_t generation; // Bumped once per parallelFor call
+    std::atomic<int> finished; // Workers done with the current generation
+    bool stopping;
+    void (*job)(void*, int, int); // Type-erased call into the current job's functor
+    void* jobContext;
+
+    static int resolveThreads(int threads)
+    {
+        if (threads > 0)
+        {
+            return threads;
+        }
+        unsigned hw = std::thread::hardware_concurrency();
+        return hw ? static_cast<int>(hw) : 1;
+    }
+
+    // Function to drain this worker's slice, then steal from the others until everything is empty
+    void runJob(int self)
+    {
+        int n = size();
+        for (;;)
+        {
+            int64_t index;
+            while ((index = slices[self].take()) >= 0)
+            {
+                job(jobContext, static_cast<int>(index), self);
+            }
+
+            // Own slice is empty: steal half of someone else's
+            bool stole = false;
+            for (int k = 1; k < n && !stole; k++)
+            {
+                uint32_t begin, end;
+                if (slices[(self + k) % n].steal(begin, end))
+                {
+                    slices[self].range.store(WorkSlice::pack(begin, end), std::memory_order_release);
+                    stole = true;
+                }
+            }
+            if (!stole)
+            {
+                return;
+            }
+        }
+    }
+
+    // Function run by each pool thread: wait for a job, help with it, report back
+    void workerLoop(int self)
+    {
+        uint64_t seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [&] { return stopping || generation != seen; });
+                if (stopping)
+                {
+                    return;
+                }
+                seen = generation;
+            }
+            runJob(self);
+            finished.fetch_add(1, std::memory_order_release);
+        }
+    }
+};
+
+#endif
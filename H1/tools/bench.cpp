@@ -0,0 +1,542 @@
+// MICROBENCHMARKS //
+// Times the engine's hot paths one at a time on fixed seeded inputs:
+// collision checks, locking a piece, clearing 0-4 lines in two row patterns,
+// the ghost/drop distance, hard drop, move generation, board evaluation, the
+// piece randomizer and whole headless games, then collision, line clears and
+// games again on larger boards (size_WxH_*) to compare them with the classic
+// 10x20 one. Each benchmark is run several times and the best
+// ns/op is reported as CSV; the fastest run is the one least disturbed by
+// other load, so it is the most repeatable. With --baseline the results are
+// compared against a file written earlier with --save, and the program exits
+// with status 2 if any benchmark got slower by more than the threshold.
+//
+// Build (from H1/tools): g++ -std=c++17 -O2 -pthread -I.. bench.cpp -o bench
+// Usage: bench [--filter TEXT] [--save FILE] [--baseline FILE] [--threshold PCT] [--runs R]
+
+#include "algorithm"
+#include "chrono"
+#include "cstdio"
+#include "cstdlib"
+#include "cstring"
+#include "string"
+#include "vector"
+#include "ai.h"
+#include "batch_runner.h"
+#include "movegen.h"
+#include "tool_args.h"
+
+using namespace std;
+
+volatile uint64_t benchSink; // Results are folded in here so the compiler cannot drop the work
+
+const int BENCH_BOARDS = 64; // Seeded mid-game boards shared by the benchmarks
+const double BENCH_MIN_SECONDS = 0.05; // Shortest time one timed run may take
+
+// Struct for one benchmark result
+struct BenchResult
+{
+    string name;
+    double nsPerOp;
+};
+
+// Function to time `body` (which does `opsPerCall` operations per call) and get the best ns/op over `runs` runs
+template <typename Fn>
+double measure(Fn&& body, long long opsPerCall, int runs)
+{
+    // Grow the call count until one run is long enough to time reliably
+    long long calls = 1;
+    while (true)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (long long i = 0; i < calls; i++)
+        {
+            body();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (seconds >= BENCH_MIN_SECONDS)
+        {
+            break;
+        }
+        calls *= 2;
+    }
+
+    double best = 0;
+    for (int r = 0; r < runs; r++)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (long long i = 0; i < calls; i++)
+        {
+            body();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        double ns = seconds * 1e9 / (calls * opsPerCall);
+        best = (r == 0 || ns < best) ? ns : best;
+    }
+    return best;
+}
+
+// Function to build the shared boards: each is a seeded random game stopped after 10 to 40 pieces (scaled up with the board's area)
+template <int W = GRID_WIDTH, int H = GRID_HEIGHT>
+vector<BasicBoard<W, H>> seeded_boards()
+{
+    vector<BasicBoard<W, H>> boards;
+    for (int i = 0; i < BENCH_BOARDS; i++)
+    {
+        BasicGameSession<W, H> session;
+        session.reset(1, game_seed(42, i));
+        RandomPlayer player(game_seed(7, i));
+        int pieces = (10 + i % 31) * (W * H) / (GRID_WIDTH * GRID_HEIGHT);
+        for (int p = 0; p < pieces && !session.gameOver; p++)
+        {
+            player.playPiece(session);
+        }
+        boards.push_back(session.board);
+    }
+    return boards;
+}
+
+// Function to build a board with `lines` full rows at the bottom ("stacked") or spread between partial rows ("split"),
+// under a stack `stack` rows tall
+template <int W = GRID_WIDTH, int H = GRID_HEIGHT>
+BasicBoard<W, H> line_clear_board(int lines, bool split, uint32_t seed, int stack = 10)
+{
+    typedef BasicBoard<W, H> B;
+    typedef typename B::Row Row;
+    B board;
+    RandomPlayer rng(seed);
+    int full = 0;
+    for (int y = H - 1; y >= H - stack; y--)
+    {
+        bool makeFull = full < lines && (!split || (H - 1 - y) % 2 == 0);
+        Row row = makeFull ? B::FULL : static_cast<Row>(B::FULL & ~(Row(1) << rng.next(W)));
+        full += makeFull;
+        for (int x = 0; x < W; x++)
+        {
+            if (row & (Row(1) << x))
+            {
+                board.rows[y] |= static_cast<Row>(Row(1) << x);
+                board.colors[y][x] = 1;
+                board.hash ^= B::KEYS.cells[y][x];
+            }
+        }
+    }
+    board.recomputeHeights();
+    return board;
+}
+
+// Function to time collision, a 4-line clear under a stack half the board tall and whole random games on a W x H board
+template <int W, int H, typename Run>
+void bench_board_size(Run& run)
+{
+    char name[64];
+    vector<BasicBoard<W, H>> boards = seeded_boards<W, H>();
+
+    // Collision: every rotation of every shape at every column, at a third and two thirds of the way down
+    snprintf(name, sizeof(name), "size_%dx%d_collides", W, H);
+    run(name, BENCH_BOARDS * 7 * 4 * (W + 3) * 2, [&]()
+    {
+        uint64_t hits = 0;
+        for (const BasicBoard<W, H>& b : boards)
+        {
+            for (int s = 0; s < 7; s++)
+            {
+                for (int r = 0; r < 4; r++)
+                {
+                    const ShapeInfo& info = shape_info(s, r);
+                    for (int x = -3; x < W; x++)
+                    {
+                        hits += b.collides(info, x, H / 3);
+                        hits += b.collides(info, x, H * 2 / 3);
+                    }
+                }
+            }
+        }
+        benchSink += hits;
+    });
+
+    // Line clear, per row of the stack, so sizes with the same stack-to-board ratio can be compared directly
+    vector<BasicBoard<W, H>> clearBoards;
+    for (int i = 0; i < 16; i++)
+    {
+        clearBoards.push_back(line_clear_board<W, H>(4, true, game_seed(W * H, i), H / 2));
+    }
+    snprintf(name, sizeof(name), "size_%dx%d_clear_4_per_row", W, H);
+    run(name, static_cast<long long>(clearBoards.size()) * (H / 2), [&]()
+    {
+        for (const BasicBoard<W, H>& source : clearBoards)
+        {
+            BasicBoard<W, H> b = source;
+            benchSink += b.clearFullRows();
+        }
+    });
+
+    // Whole games with the random player, per piece placed
+    const int GAME_COUNT = 16;
+    long long gamePieces = 0;
+    for (int g = 0; g < GAME_COUNT; g++)
+    {
+        BasicGameSession<W, H> session;
+        session.reset(1, game_seed(5, g));
+        RandomPlayer player(game_seed(6, g));
+        while (!session.gameOver)
+        {
+            player.playPiece(session);
+            gamePieces++;
+        }
+    }
+    snprintf(name, sizeof(name), "size_%dx%d_game_per_piece", W, H);
+    run(name, gamePieces, [&]()
+    {
+        for (int g = 0; g < GAME_COUNT; g++)
+        {
+            BasicGameSession<W, H> session;
+            session.reset(1, game_seed(5, g));
+            RandomPlayer player(game_seed(6, g));
+            while (!session.gameOver)
+            {
+                player.playPiece(session);
+            }
+            benchSink += session.stats.score;
+        }
+    });
+}
+
+// Function to read a baseline written by --save; returns false if the file cannot be opened
+bool load_baseline(const char* path, vector<BenchResult>& out)
+{
+    FILE* f = fopen(path, "r");
+    if (!f)
+    {
+        return false;
+    }
+    char name[128];
+    double ns;
+    while (fscanf(f, "%127s %lf", name, &ns) == 2)
+    {
+        out.push_back({name, ns});
+    }
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    const char* filter = "";
+    const char* savePath = nullptr;
+    const char* baselinePath = nullptr;
+    double threshold = 10; // Percent
+    int runs = 7;
+
+    ToolArgs args(argc, argv, 1);
+    const char* v;
+    while (args.next())
+    {
+        if (args.option("--filter", v)) filter = v;
+        else if (args.option("--save", v)) savePath = v;
+        else if (args.option("--baseline", v)) baselinePath = v;
+        else if (args.option("--threshold", v)) threshold = atof(v);
+        else if (args.option("--runs", v)) runs = max(1, atoi(v));
+        else args.unknown();
+    }
+    if (!args.ok())
+    {
+        return 1;
+    }
+
+    vector<BenchResult> baseline;
+    if (baselinePath && !load_baseline(baselinePath, baseline))
+    {
+        fprintf(stderr, "could not read baseline %s\n", baselinePath);
+        return 1;
+    }
+
+    vector<Board> boards = seeded_boards();
+    vector<BenchResult> results;
+    auto run = [&](const char* name, long long opsPerCall, auto&& body)
+    {
+        if (strstr(name, filter))
+        {
+            results.push_back({name, measure(body, opsPerCall, runs)});
+        }
+    };
+
+    // Collision: every rotation of every shape at every column, two rows, on every board
+    run("collides", BENCH_BOARDS * 7 * 4 * 13 * 2, [&]()
+    {
+        uint64_t hits = 0;
+        for (const Board& b : boards)
+        {
+            for (int s = 0; s < 7; s++)
+            {
+                for (int r = 0; r < 4; r++)
+                {
+                    const ShapeInfo& info = shape_info(s, r);
+                    for (int x = -3; x < GRID_WIDTH; x++)
+                    {
+                        hits += b.collides(info, x, 4);
+                        hits += b.collides(info, x, 12);
+                    }
+                }
+            }
+        }
+        benchSink += hits;
+    });
+
+    // Ghost: landing row from the skyline for every shape, rotation and column, on every board
+    run("drop_distance", BENCH_BOARDS * 7 * 4 * 13, [&]()
+    {
+        uint64_t total = 0;
+        for (const Board& b : boards)
+        {
+            for (int s = 0; s < 7; s++)
+            {
+                for (int r = 0; r < 4; r++)
+                {
+                    const ShapeInfo& info = shape_info(s, r);
+                    for (int x = -3; x < GRID_WIDTH; x++)
+                    {
+                        if (!b.collides(info, x, 0))
+                        {
+                            total += b.dropDistance(info, x, 0);
+                        }
+                    }
+                }
+            }
+        }
+        benchSink += total;
+    });
+
+    // The same landing rows found by stepping down one row at a time, for comparison
+    run("drop_distance_scan", BENCH_BOARDS * 7 * 4 * 13, [&]()
+    {
+        uint64_t total = 0;
+        for (const Board& b : boards)
+        {
+            for (int s = 0; s < 7; s++)
+            {
+                for (int r = 0; r < 4; r++)
+                {
+                    const ShapeInfo& info = shape_info(s, r);
+                    for (int x = -3; x < GRID_WIDTH; x++)
+                    {
+                        if (!b.collides(info, x, 0))
+                        {
+                            total += b.scanDropDistance(info, x, 0);
+                        }
+                    }
+                }
+            }
+        }
+        benchSink += total;
+    });
+
+    // Lock: copy a board and place a T at its landing row in the middle
+    run("lock", BENCH_BOARDS, [&]()
+    {
+        const ShapeInfo& info = shape_info(5, 0);
+        for (const Board& source : boards)
+        {
+            Board b = source;
+            if (!b.collides(info, SPAWN_X, 0))
+            {
+                b.place(info, SPAWN_X, b.dropDistance(info, SPAWN_X, 0), 6);
+            }
+            benchSink += b.hash;
+        }
+    });
+
+    // Line clears: copy a board and clear 0-4 full rows, stacked at the bottom or split by partial rows
+    static const char* CLEAR_NAMES[2][5] = {{"clear_0_stacked", "clear_1_stacked", "clear_2_stacked", "clear_3_stacked", "clear_4_stacked"},
+                                            {"clear_0_split", "clear_1_split", "clear_2_split", "clear_3_split", "clear_4_split"}};
+    for (int split = 0; split < 2; split++)
+    {
+        for (int lines = 0; lines <= 4; lines++)
+        {
+            vector<Board> clearBoards;
+            for (int i = 0; i < 16; i++)
+            {
+                clearBoards.push_back(line_clear_board(lines, split != 0, game_seed(lines * 2 + split, i)));
+            }
+            run(CLEAR_NAMES[split][lines], static_cast<long long>(clearBoards.size()), [&]()
+            {
+                for (const Board& source : clearBoards)
+                {
+                    Board b = source;
+                    benchSink += b.clearFullRows();
+                }
+            });
+        }
+    }
+
+    // Hard drop through the session: ghost, lock, line clear, scoring and spawn
+    vector<GameSession> sessions;
+    for (int i = 0; i < BENCH_BOARDS; i++)
+    {
+        GameSession session;
+        session.reset(1, game_seed(99, i));
+        session.board = boards[i];
+        session.ghostValid = false;
+        sessions.push_back(session);
+    }
+    run("hard_drop", BENCH_BOARDS, [&]()
+    {
+        for (const GameSession& source : sessions)
+        {
+            GameSession s = source;
+            benchSink += s.apply(ACTION_HARD_DROP);
+        }
+    });
+
+    // Every placement of a T on every board
+    MoveGenerator gen;
+    PlacementList list;
+    run("movegen", BENCH_BOARDS, [&]()
+    {
+        for (const Board& b : boards)
+        {
+            benchSink += gen.generate(b, Tetromino(5, 0, SPAWN_X, SPAWN_Y), list);
+        }
+    });
+
+    // Board evaluation, one board at a time and in batches
+    EvalWeights weights;
+    run("evaluate_board", BENCH_BOARDS, [&]()
+    {
+        double total = 0;
+        for (const Board& b : boards)
+        {
+            total += evaluate_board(b, 0, weights);
+        }
+        benchSink += static_cast<uint64_t>(total);
+    });
+    BoardBatch batch;
+    FeatureBatch features;
+    run("evaluate_batch", BENCH_BOARDS, [&]()
+    {
+        for (int first = 0; first < BENCH_BOARDS; first += FEATURE_BATCH)
+        {
+            batch.count = 0;
+            for (int i = first; i < first + FEATURE_BATCH; i++)
+            {
+                batch.add(boards[i]);
+            }
+            compute_features(batch, features);
+            benchSink += features.holes[0];
+        }
+    });
+
+    // Drawing pieces one at a time, jumping straight to one, and filling a buffer in bulk
+    const int PIECE_RUN = 4096;
+    uint8_t pieces[PIECE_RUN];
+    PieceRandomizer uniform;
+    uniform.reset(9, RANDOMIZER_UNIFORM);
+    run("randomizer_next_uniform", PIECE_RUN, [&]()
+    {
+        for (int i = 0; i < PIECE_RUN; i++)
+        {
+            benchSink += uniform.next();
+        }
+    });
+    PieceRandomizer bag;
+    bag.reset(9, RANDOMIZER_BAG);
+    run("randomizer_next_bag", PIECE_RUN, [&]()
+    {
+        for (int i = 0; i < PIECE_RUN; i++)
+        {
+            benchSink += bag.next();
+        }
+    });
+    run("randomizer_piece_at_bag", PIECE_RUN, [&]()
+    {
+        for (int i = 0; i < PIECE_RUN; i++)
+        {
+            benchSink += bag.pieceAt(static_cast<uint64_t>(i) * 1000003);
+        }
+    });
+    run("randomizer_generate_bag", PIECE_RUN, [&]()
+    {
+        bag.generate(bag.index, PIECE_RUN, pieces);
+        benchSink += pieces[PIECE_RUN - 1];
+    });
+
+    // Whole games with the random player on one thread, per piece placed
+    const int GAME_COUNT = 64;
+    long long gamePieces = 0;
+    for (int g = 0; g < GAME_COUNT; g++)
+    {
+        GameSession session;
+        session.reset(1, game_seed(5, g));
+        RandomPlayer player(game_seed(6, g));
+        while (!session.gameOver)
+        {
+            player.playPiece(session);
+            gamePieces++;
+        }
+    }
+    run("game_random_per_piece", gamePieces, [&]()
+    {
+        for (int g = 0; g < GAME_COUNT; g++)
+        {
+            GameSession session;
+            session.reset(1, game_seed(5, g));
+            RandomPlayer player(game_seed(6, g));
+            while (!session.gameOver)
+            {
+                player.playPiece(session);
+            }
+            benchSink += session.stats.score;
+        }
+    });
+
+    // The same hot paths on the classic board and on boards that need 16-, 32- and 64-bit rows
+    bench_board_size<GRID_WIDTH, GRID_HEIGHT>(run);
+    bench_board_size<16, 32>(run);
+    bench_board_size<32, 64>(run);
+    bench_board_size<64, 128>(run);
+
+    // Report, and compare with the baseline if there is one
+    bool regressed = false;
+    printf("name,ns_per_op,baseline_ns_per_op,change_pct,status\n");
+    for (const BenchResult& r : results)
+    {
+        const BenchResult* base = nullptr;
+        for (const BenchResult& b : baseline)
+        {
+            if (b.name == r.name)
+            {
+                base = &b;
+            }
+        }
+        if (!base)
+        {
+            printf("%s,%.3f,,,new\n", r.name.c_str(), r.nsPerOp);
+            continue;
+        }
+        double change = (r.nsPerOp / base->nsPerOp - 1) * 100;
+        bool slower = change > threshold;
+        regressed = regressed || slower;
+        printf("%s,%.3f,%.3f,%+.1f,%s\n", r.name.c_str(), r.nsPerOp, base->nsPerOp, change, slower ? "REGRESSED" : "ok");
+    }
+
+    if (savePath)
+    {
+        FILE* f = fopen(savePath, "w");
+        if (!f)
+        {
+            fprintf(stderr, "could not write %s\n", savePath);
+            return 1;
+        }
+        for (const BenchResult& r : results)
+        {
+            fprintf(f, "%s %.3f\n", r.name.c_str(), r.nsPerOp);
+        }
+        fclose(f);
+    }
+
+    if (regressed)
+    {
+        fprintf(stderr, "regression: at least one benchmark is more than %.1f%% slower than the baseline\n", threshold);
+        return 2;
+    }
+    return 0;
+}
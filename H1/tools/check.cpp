@@ -0,0 +1,263 @@
+// CHECKS //
+// Self-checks for the parts of the engine the other tools do not exercise.
+// Each check prints one line, ok or FAILED with what went wrong, and the
+// program exits with status 2 if any failed.
+//
+//   scores  writes a score log, damages a record in the middle and the tail,
+//           and checks that a reload skips only the damaged records, keeps
+//           every good one after them and cuts off only the torn tail
+//   features runs the vectorized board features (eval_features.h) and the
+//           scalar kernel on the same random boards and compares every lane;
+//           it needs a build with -mavx2 or -msse4.1 to have anything to compare
+//
+// Build (from H1/tools): g++ -std=c++17 -O2 -pthread -I.. check.cpp -o check
+//        (add -mavx2 or -msse4.1 to check that kernel; build once per instruction set shipped)
+// Usage: check [--dir D] [--boards N]
+
+#include "chrono"
+#include "cstdio"
+#include "cstdlib"
+#include "cstring"
+#include "string"
+#include "thread"
+#include "eval_features.h"
+#include "randomizer.h"
+#include "score_store.h"
+#include "tool_args.h"
+
+using namespace std;
+
+const int CHECK_SCORE_RECORDS = 10;
+const uint64_t CHECK_FEATURE_SEED = 0xFEA7; // Random stream for the feature check's boards
+
+// Function to report one check; returns 1 if it failed
+int report(const char* name, const char* failure)
+{
+    if (failure)
+    {
+        printf("%-8s FAILED: %s\n", name, failure);
+        return 1;
+    }
+    printf("%-8s ok\n", name);
+    return 0;
+}
+
+// Function to open a score log and wait until its index is ready
+void open_scores(ScoreStore& store, const string& path)
+{
+    store.open(path.c_str());
+    while (!store.poll())
+    {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+}
+
+// Function to get a file's size in bytes, or -1 if it cannot be read
+long long file_size(const string& path)
+{
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f)
+    {
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+// Function to change bytes of a file in place (past its end appends them)
+bool poke_file(const string& path, long long at, const uint8_t* bytes, size_t count)
+{
+    FILE* f = fopen(path.c_str(), "r+b");
+    if (!f)
+    {
+        return false;
+    }
+    fseek(f, static_cast<long>(at), SEEK_SET);
+    bool ok = fwrite(bytes, 1, count, f) == count;
+    return fclose(f) == 0 && ok;
+}
+
+// Function to check that damage in a score log loses only the damaged records; returns what failed, or nullptr
+const char* check_scores(const string& dir)
+{
+    string path = dir + "/check_scores.bin";
+    remove(path.c_str());
+    {
+        ScoreStore store;
+        open_scores(store, path);
+        for (int i = 0; i < CHECK_SCORE_RECORDS; i++)
+        {
+            ScoreRecord r = {100 * (i + 1), 1, 1, i, static_cast<uint32_t>(i), 0};
+            store.add(r);
+        }
+        store.close();
+        if (store.error())
+        {
+            return "could not write the log";
+        }
+    }
+    const long long fullSize = SCORE_LOG_HEADER_BYTES + CHECK_SCORE_RECORDS * SCORE_RECORD_BYTES;
+    if (file_size(path) != fullSize)
+    {
+        return "the new log has the wrong size";
+    }
+
+    // Flip a byte inside the third record
+    FILE* f = fopen(path.c_str(), "rb");
+    uint8_t byte = 0;
+    long long at = SCORE_LOG_HEADER_BYTES + 2 * SCORE_RECORD_BYTES + 5;
+    if (!f || fseek(f, static_cast<long>(at), SEEK_SET) != 0 || fread(&byte, 1, 1, f) != 1)
+    {
+        return "could not read the log back";
+    }
+    fclose(f);
+    byte ^= 0x40;
+    if (!poke_file(path, at, &byte, 1))
+    {
+        return "could not damage the log";
+    }
+    {
+        ScoreStore store;
+        open_scores(store, path);
+        store.close();
+        if (store.count() != CHECK_SCORE_RECORDS - 1 || store.corrupt != 1)
+        {
+            return "a damaged middle record cost more than itself";
+        }
+        if (store.best() != 100 * CHECK_SCORE_RECORDS || store.rank(100 * CHECK_SCORE_RECORDS) != 1)
+        {
+            return "the records after a damaged one were not loaded";
+        }
+        if (file_size(path) != fullSize)
+        {
+            return "a damaged middle record shrank the file";
+        }
+    }
+
+    // A torn append after the good records: only it is cut off, and new games follow the good data
+    uint8_t torn[SCORE_RECORD_BYTES / 2];
+    memset(torn, 0xA5, sizeof(torn));
+    if (!poke_file(path, fullSize, torn, sizeof(torn)))
+    {
+        return "could not append a torn record";
+    }
+    {
+        ScoreStore store;
+        open_scores(store, path);
+        ScoreRecord r = {50, 1, 1, 0, 99, 0};
+        store.add(r);
+        store.close();
+        if (store.count() != CHECK_SCORE_RECORDS || store.corrupt != 2)
+        {
+            return "a torn tail was not counted as one damaged record";
+        }
+        if (file_size(path) != fullSize + SCORE_RECORD_BYTES)
+        {
+            return "a torn tail was not replaced by the next game";
+        }
+    }
+    {
+        ScoreStore store;
+        open_scores(store, path);
+        store.close();
+        if (store.count() != CHECK_SCORE_RECORDS || store.corrupt != 1 || store.best() != 100 * CHECK_SCORE_RECORDS)
+        {
+            return "records were lost across reloads";
+        }
+    }
+    remove(path.c_str());
+    return nullptr;
+}
+
+#if defined(__AVX2__)
+const char* FEATURE_KERNEL = "AVX2";
+#elif defined(__SSE4_1__)
+const char* FEATURE_KERNEL = "SSE4.1";
+#else
+const char* FEATURE_KERNEL = nullptr;
+#endif
+
+// Function to fill a batch with random boards: a random empty stretch on top, then rows of random density
+void random_batch(BoardBatch& batch, uint64_t& counter)
+{
+    batch.clear();
+    while (batch.count < FEATURE_BATCH)
+    {
+        Board b;
+        int top = static_cast<int>(random_at(CHECK_FEATURE_SEED, counter++) % (GRID_HEIGHT + 1));
+        int density = static_cast<int>(random_at(CHECK_FEATURE_SEED, counter++) % 4);
+        for (int y = top; y < GRID_HEIGHT; y++)
+        {
+            uint64_t bits = random_at(CHECK_FEATURE_SEED, counter++);
+            for (int d = 0; d < density; d++)
+            {
+                bits |= random_at(CHECK_FEATURE_SEED, counter++); // Denser rows, up to full ones
+            }
+            b.rows[y] = static_cast<RowBits>(bits & FULL_ROW);
+        }
+        batch.add(b);
+    }
+}
+
+// Function to check that the vectorized features match the scalar kernel on random boards; returns what failed, or nullptr
+const char* check_features(int batches)
+{
+    BoardBatch batch;
+    FeatureBatch vectorized, scalar;
+    uint64_t counter = 0;
+    for (int i = 0; i < batches; i++)
+    {
+        random_batch(batch, counter);
+        compute_features(batch, vectorized);
+        for (int lane = 0; lane < batch.count; lane++)
+        {
+            compute_features_scalar(batch, lane, scalar);
+            bool same = vectorized.aggregateHeight[lane] == scalar.aggregateHeight[lane] && vectorized.holes[lane] == scalar.holes[lane]
+                        && vectorized.bumpiness[lane] == scalar.bumpiness[lane] && vectorized.rowTransitions[lane] == scalar.rowTransitions[lane]
+                        && vectorized.columnTransitions[lane] == scalar.columnTransitions[lane] && vectorized.wells[lane] == scalar.wells[lane];
+            for (int c = 0; c < GRID_WIDTH; c++)
+            {
+                same = same && vectorized.heights[c][lane] == scalar.heights[c][lane];
+            }
+            if (!same)
+            {
+                return "a board's vectorized features differ from the scalar kernel";
+            }
+        }
+    }
+    return nullptr;
+}
+
+int main(int argc, char** argv)
+{
+    string dir = ".";
+    int boards = 1000000;
+
+    ToolArgs args(argc, argv, 1);
+    const char* v;
+    while (args.next())
+    {
+        if (args.option("--dir", v)) dir = v;
+        else if (args.option("--boards", v)) boards = atoi(v);
+        else args.unknown();
+    }
+    if (!args.ok())
+    {
+        return 1;
+    }
+
+    int failures = 0;
+    failures += report("scores", check_scores(dir));
+    if (FEATURE_KERNEL)
+    {
+        printf("features: %s kernel against the scalar one on %d random boards\n", FEATURE_KERNEL, boards);
+        failures += report("features", check_features((boards + FEATURE_BATCH - 1) / FEATURE_BATCH));
+    }
+    else
+    {
+        printf("features skipped: this build has only the scalar kernel (build with -mavx2 or -msse4.1)\n");
+    }
+    return failures ? 2 : 0;
+}
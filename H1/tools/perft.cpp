@@ -0,0 +1,100 @@
+// PERFT //
+// Counts leaf placements to depth 1..N over a fixed piece sequence on an
+// empty board, and reports placements/sec. The counts must not change unless
+// the game rules change; the rate is the number to track across releases.
+//
+// Build (from H1/tools): g++ -std=c++17 -O2 -pthread -I.. perft.cpp -o perft
+// Usage: perft [--depth N] [--pieces TIOLJSZ] [--threads T]
+
+#include "chrono"
+#include "cstdio"
+#include "cstdlib"
+#include "cstring"
+#include "vector"
+#include "movegen.h"
+#include "thread_pool.h"
+#include "tool_args.h"
+
+using namespace std;
+
+// Function to turn a piece letter into a shape index (same order as SHAPES); returns -1 if unknown
+int shape_from_letter(char c)
+{
+    const char* letters = "IJLOSTZ";
+    const char* found = strchr(letters, c);
+    return (found && c) ? static_cast<int>(found - letters) : -1;
+}
+
+int main(int argc, char** argv)
+{
+    int depth = 4;
+    const char* sequence = "TIOLJSZT";
+    int threads = 0; // 0 = one per hardware thread
+
+    ToolArgs args(argc, argv, 1);
+    const char* v;
+    while (args.next())
+    {
+        if (args.option("--depth", v)) depth = atoi(v);
+        else if (args.option("--pieces", v)) sequence = v;
+        else if (args.option("--threads", v)) threads = atoi(v);
+        else args.unknown();
+    }
+    if (!args.ok())
+    {
+        return 1;
+    }
+
+    int pieces[PERFT_MAX_DEPTH];
+    int length = static_cast<int>(strlen(sequence));
+    if (depth < 1 || depth > PERFT_MAX_DEPTH || depth > length)
+    {
+        fprintf(stderr, "depth must be 1..%d and no longer than the piece sequence\n", PERFT_MAX_DEPTH);
+        return 1;
+    }
+    for (int i = 0; i < depth; i++)
+    {
+        pieces[i] = shape_from_letter(sequence[i]);
+        if (pieces[i] < 0)
+        {
+            fprintf(stderr, "unknown piece '%c'\n", sequence[i]);
+            return 1;
+        }
+    }
+
+    WorkStealingPool pool(threads);
+    vector<Perft> perfts(pool.size());
+    Board empty;
+
+    printf("depth %8s %16s %10s %14s\n", "pieces", "leaves", "seconds", "leaves/sec");
+    for (int d = 1; d <= depth; d++)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        // Split the work at the root: each root placement is one task
+        PlacementList& roots = perfts[0].lists[PERFT_MAX_DEPTH - 1];
+        int n = perfts[0].gen.generate(empty, Tetromino(pieces[0], 0, SPAWN_X, SPAWN_Y), roots);
+        vector<uint64_t> leaves(n, 0);
+        if (d == 1)
+        {
+            leaves.assign(n, 1);
+        }
+        else
+        {
+            pool.parallelFor(n, [&](int index, int worker)
+            {
+                Board next = Perft::apply(empty, pieces[0], roots.items[index]);
+                leaves[index] = perfts[worker].count(next, pieces + 1, d - 1);
+            });
+        }
+
+        uint64_t total = 0;
+        for (uint64_t l : leaves)
+        {
+            total += l;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        printf("%5d %8.*s %16llu %10.3f %14.0f\n", d, d, sequence, static_cast<unsigned long long>(total), seconds, seconds > 0 ? total / seconds : 0.0);
+    }
+    return 0;
+}
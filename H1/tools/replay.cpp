@@ -0,0 +1,387 @@
+// REPLAY TOOL //
+// Records seeded headless games as replay files, or re-runs a directory of
+// them across every core as a performance workload: every replay is mapped,
+// re-simulated to its last tick and checked for desyncs, then optionally
+// seeked to random ticks through its keyframes, each seek checked against
+// playing straight to the same tick. Recorded games are short, so `record`
+// writes a keyframe every REPLAY_TOOL_KEYFRAME_TICKS ticks (not the game's
+// REPLAY_KEYFRAME_TICKS) to make seeks restore keyframes past the first one.
+// `rollback` checks the
+// rollback buffer: games are played tick by tick, and every so often an
+// earlier tick's inputs are corrected and re-simulated, or the game is
+// rewound; each time the result must match a straight replay of the
+// corrected inputs from the start.
+//
+// Build (from H1/tools): g++ -std=c++17 -O2 -pthread -I.. replay.cpp -o replay
+// Usage: replay record [--games N] [--dir D] [--seed S] [--threads T] [--randomizer uniform|bag] [--keyframe-ticks K]
+//        replay play   [--games N] [--dir D] [--threads T] [--seeks K]
+//        replay rollback [--games N] [--seed S] [--threads T]
+
+#include "algorithm"
+#include "chrono"
+#include "cstdio"
+#include "cstdlib"
+#include "cstring"
+#include "memory"
+#include "string"
+#include "vector"
+#include "batch_runner.h"
+#include "replay.h"
+#include "rollback.h"
+#include "tool_args.h"
+
+using namespace std;
+
+// Function to get the path of one game's replay in a directory
+string replay_path(const string& dir, int index)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/game_%05d.ttr", index);
+    return dir + name;
+}
+
+const int REPLAY_TOOL_KEYFRAME_TICKS = 120; // Default keyframe interval for recorded games, which last a few hundred ticks
+
+// Struct for what a seek must reproduce: the board and piece, the score and how far the piece sequence has got
+struct SeekPosition
+{
+    uint64_t hash;
+    int score;
+    uint32_t pieces;
+
+    explicit SeekPosition(const GameSession& s) : hash(s.hash()), score(s.stats.score), pieces(s.randomizer.index) {}
+
+    bool operator==(const SeekPosition& o) const
+    {
+        return hash == o.hash && score == o.score && pieces == o.pieces;
+    }
+};
+
+// Function to play one game the way a person would: some ticks (sometimes with soft drop) between pieces
+void play_recorded_game(GameSession& session, RandomPlayer& player)
+{
+    while (!session.gameOver)
+    {
+        int ticks = player.next(40);
+        bool softDrop = player.next(4) == 0;
+        for (int i = 0; i < ticks && !session.gameOver; i++)
+        {
+            session.tick(softDrop);
+        }
+        if (!session.gameOver)
+        {
+            player.playPiece(session);
+        }
+    }
+}
+
+const int ROLLBACK_CHECK_MAX_TICKS = 20000; // Longest game the rollback check plays
+
+// Struct for the rollback check's counters
+struct RollbackCounters
+{
+    long long ticks = 0;
+    long long resimulations = 0;
+    long long rewinds = 0;
+    long long refused = 0; // resimulate() calls that returned false
+    long long mismatches = 0;
+};
+
+// Struct for one worker's rollback check, padded so workers never share a cache line
+struct alignas(64) RollbackWorker : RollbackCounters
+{
+    GameSession session; // The game with the rollback buffer attached
+    GameSession straight; // The same inputs played from the start, to compare with
+    RollbackBuffer rollback;
+    vector<TickInputs> script; // Inputs of every finished tick, including corrections
+};
+
+// Function to play the first `ticks` ticks of a script on a fresh session
+void play_script(GameSession& s, int level, uint32_t seed, const vector<TickInputs>& script, size_t ticks)
+{
+    s.reset(level, seed);
+    for (size_t t = 0; t < ticks; t++)
+    {
+        for (int a = 0; a < script[t].actionCount; a++)
+        {
+            s.apply(static_cast<GameAction>(script[t].actions[a]));
+        }
+        s.tick(script[t].softDrop != 0);
+    }
+}
+
+// Function to play one game with random inputs, correcting and re-simulating or rewinding every so often,
+// and count every time the result differs from a straight replay
+void check_rollback(RollbackWorker& w, int level, uint32_t seed)
+{
+    GameSession& s = w.session;
+    s.reset(level, seed);
+    w.rollback.clear();
+    w.script.clear();
+    RandomPlayer rng(seed ^ 0x5BD1E995u);
+    bool softDrop = false;
+
+    while (!s.gameOver && w.script.size() < static_cast<size_t>(ROLLBACK_CHECK_MAX_TICKS))
+    {
+        // One tick of play: maybe an action, maybe a change of the soft drop key, then gravity
+        TickInputs in = {};
+        if (rng.next(8) == 0)
+        {
+            uint8_t action = static_cast<uint8_t>(rng.next(5));
+            s.apply(static_cast<GameAction>(action));
+            in.actions[in.actionCount++] = action;
+        }
+        if (rng.next(30) == 0)
+        {
+            softDrop = !softDrop;
+        }
+        in.softDrop = softDrop ? 1 : 0;
+        s.tick(softDrop);
+        w.script.push_back(in);
+        w.ticks++;
+        if (s.gameOver || rng.next(120) != 0)
+        {
+            continue;
+        }
+
+        long long now = w.rollback.currentTick();
+        long long kept = now - w.rollback.oldestTick();
+        if (kept <= 0)
+        {
+            continue;
+        }
+        s.highScore = static_cast<int>(now); // As if the score log finished loading just now; no rollback may take it back
+        if (rng.next(2) == 0)
+        {
+            // Correct one kept tick by adding a move, as if a late input had arrived, then re-simulate from it
+            long long target = now - 1 - rng.next(static_cast<int>(kept));
+            TickInputs& fix = w.rollback.inputsAt(target);
+            if (fix.actionCount >= ROLLBACK_MAX_ACTIONS)
+            {
+                continue;
+            }
+            uint8_t action = static_cast<uint8_t>(rng.next(4));
+            fix.actions[fix.actionCount++] = action;
+            TickInputs& scripted = w.script[static_cast<size_t>(target)];
+            scripted.actions[scripted.actionCount++] = action;
+            if (!w.rollback.resimulate(target))
+            {
+                w.refused++;
+                return;
+            }
+            w.resimulations++;
+        }
+        else
+        {
+            // Undo some ticks; the inputs after them are gone
+            int back = w.rollback.rewind(1 + rng.next(ROLLBACK_TICKS));
+            w.script.resize(static_cast<size_t>(now - back));
+            w.rewinds++;
+        }
+
+        play_script(w.straight, level, seed, w.script, w.script.size());
+        bool same = w.straight.hash() == s.hash() && w.straight.stats.score == s.stats.score
+                    && w.straight.stats.linesCleared == s.stats.linesCleared && w.straight.randomizer.index == s.randomizer.index
+                    && w.straight.gameOver == s.gameOver && w.straight.dropTimer == s.dropTimer && s.highScore == static_cast<int>(now);
+        w.mismatches += same ? 0 : 1;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || (strcmp(argv[1], "record") != 0 && strcmp(argv[1], "play") != 0 && strcmp(argv[1], "rollback") != 0))
+    {
+        fprintf(stderr, "usage: replay record|play|rollback [options]\n");
+        return 1;
+    }
+    bool record = strcmp(argv[1], "record") == 0;
+    int games = 1000;
+    string dir = "replays";
+    uint64_t seed = 1;
+    int threads = 0; // 0 = one per hardware thread
+    int seeks = 0; // Random seeks per replay after playing it through
+    RandomizerKind randomizer = RANDOMIZER_UNIFORM;
+    int keyframeTicks = REPLAY_TOOL_KEYFRAME_TICKS;
+
+    ToolArgs args(argc, argv, 2);
+    const char* v;
+    while (args.next())
+    {
+        if (args.option("--games", v)) games = atoi(v);
+        else if (args.option("--dir", v)) dir = v;
+        else if (args.option("--seed", v)) seed = strtoull(v, nullptr, 10);
+        else if (args.option("--threads", v)) threads = atoi(v);
+        else if (args.option("--seeks", v)) seeks = atoi(v);
+        else if (args.option("--randomizer", v)) randomizer = strcmp(v, "bag") == 0 ? RANDOMIZER_BAG : RANDOMIZER_UNIFORM;
+        else if (args.option("--keyframe-ticks", v)) keyframeTicks = max(1, atoi(v));
+        else args.unknown();
+    }
+    if (!args.ok())
+    {
+        return 1;
+    }
+
+    WorkStealingPool pool(threads);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    if (strcmp(argv[1], "rollback") == 0)
+    {
+        vector<unique_ptr<RollbackWorker>> checkers;
+        for (int i = 0; i < pool.size(); i++)
+        {
+            checkers.emplace_back(new RollbackWorker());
+            checkers.back()->rollback.attach(checkers.back()->session);
+        }
+        pool.parallelFor(games, [&](int index, int worker)
+        {
+            check_rollback(*checkers[worker], 1 + index % MAX_LEVEL, game_seed(seed, index));
+        });
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        RollbackCounters total;
+        for (unique_ptr<RollbackWorker>& w : checkers)
+        {
+            total.ticks += w->ticks;
+            total.resimulations += w->resimulations;
+            total.rewinds += w->rewinds;
+            total.refused += w->refused;
+            total.mismatches += w->mismatches;
+        }
+        printf("threads      %d\n", pool.size());
+        printf("games        %d in %.3f s (%lld ticks played)\n", games, seconds, total.ticks);
+        printf("rollbacks    %lld re-simulations (%lld refused), %lld rewinds\n", total.resimulations, total.refused, total.rewinds);
+        printf("mismatched   %lld\n", total.mismatches);
+        return total.mismatches || total.refused ? 2 : 0;
+    }
+
+    if (record)
+    {
+        // One recorder per worker, each with its own writer thread
+        vector<unique_ptr<ReplayRecorder>> recorders;
+        vector<GameSession> sessions(pool.size());
+        for (int i = 0; i < pool.size(); i++)
+        {
+            recorders.emplace_back(new ReplayRecorder(true));
+            recorders.back()->keyframeTicks = keyframeTicks;
+        }
+        vector<int> failed(pool.size(), 0);
+        pool.parallelFor(games, [&](int index, int worker)
+        {
+            GameSession& session = sessions[worker];
+            uint32_t s = game_seed(seed, index);
+            int level = 1 + index % MAX_LEVEL;
+            session.randomizer.kind = static_cast<uint8_t>(randomizer);
+            session.reset(level, s);
+            if (!recorders[worker]->begin(replay_path(dir, index).c_str(), session, s, level))
+            {
+                failed[worker]++;
+                return;
+            }
+            RandomPlayer player(s ^ 0x5BD1E995u);
+            play_recorded_game(session, player);
+            recorders[worker]->end();
+        });
+        recorders.clear(); // Waits for every file to be written
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        int failures = 0;
+        for (int f : failed)
+        {
+            failures += f;
+        }
+        printf("recorded     %d games to %s in %.3f s (%d could not be opened)\n", games - failures, dir.c_str(), seconds, failures);
+        return failures ? 1 : 0;
+    }
+
+    // Struct for one worker's counters, padded so workers never share a cache line
+    struct alignas(64) PlayWorker
+    {
+        long long ticks = 0;
+        long long bytes = 0;
+        long long seeks = 0;
+        long long keyframeSeeks = 0; // Seeks that restored a keyframe after the first
+        int played = 0;
+        int missing = 0;
+        int desynced = 0;
+        int seekMismatches = 0;
+    };
+    vector<PlayWorker> workers(pool.size());
+    pool.parallelFor(games, [&](int index, int worker)
+    {
+        PlayWorker& w = workers[worker];
+        ReplayFile file;
+        ReplayPlayer player;
+        if (!file.open(replay_path(dir, index).c_str()) || !player.open(file.data, file.size))
+        {
+            w.missing++;
+            return;
+        }
+        player.runTo(player.endTick);
+        w.played++;
+        w.ticks += player.tick;
+        w.bytes += static_cast<long long>(file.size);
+        w.desynced += player.desynced ? 1 : 0;
+
+        if (seeks <= 0)
+        {
+            return;
+        }
+
+        // Every seek must land on the same position as playing straight from the start to that tick.
+        // The targets are random, then the end; a second player walks through them in order to get each expected position.
+        RandomPlayer pick(game_seed(seed, index));
+        vector<int> targets(seeks + 1);
+        for (int i = 0; i < seeks; i++)
+        {
+            targets[i] = pick.next(player.endTick + 1);
+        }
+        targets[seeks] = player.endTick;
+        vector<int> order(targets.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            order[i] = static_cast<int>(i);
+        }
+        sort(order.begin(), order.end(), [&](int a, int b) { return targets[a] < targets[b]; });
+        ReplayPlayer straight;
+        straight.open(file.data, file.size);
+        vector<SeekPosition> expected(targets.size(), SeekPosition(straight.session));
+        for (int i : order)
+        {
+            straight.runTo(targets[i]);
+            expected[i] = SeekPosition(straight.session);
+        }
+
+        for (size_t i = 0; i < targets.size(); i++)
+        {
+            player.seek(targets[i]);
+            w.seekMismatches += SeekPosition(player.session) == expected[i] ? 0 : 1;
+            w.keyframeSeeks += player.keyframes.size() > 1 && player.keyframes[1].tick <= targets[i] ? 1 : 0;
+        }
+        w.seeks += static_cast<long long>(targets.size());
+    });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    PlayWorker total;
+    for (const PlayWorker& w : workers)
+    {
+        total.ticks += w.ticks;
+        total.bytes += w.bytes;
+        total.seeks += w.seeks;
+        total.keyframeSeeks += w.keyframeSeeks;
+        total.played += w.played;
+        total.missing += w.missing;
+        total.desynced += w.desynced;
+        total.seekMismatches += w.seekMismatches;
+    }
+    printf("threads      %d\n", pool.size());
+    printf("replays      %d in %.3f s (%d missing or unreadable)\n", total.played, seconds, total.missing);
+    printf("replays/sec  %.0f\n", seconds > 0 ? total.played / seconds : 0);
+    printf("ticks/sec    %.0f (%lld ticks, %.1f bytes per 1000 ticks)\n", seconds > 0 ? total.ticks / seconds : 0, total.ticks,
+           total.ticks ? 1000.0 * total.bytes / total.ticks : 0);
+    if (seeks > 0)
+    {
+        printf("seeks        %lld, %lld at or after the second keyframe (%d landed somewhere else than straight playback)\n", total.seeks, total.keyframeSeeks,
+               total.seekMismatches);
+    }
+    printf("desynced     %d\n", total.desynced);
+    return total.desynced || total.seekMismatches ? 2 : 0;
+}
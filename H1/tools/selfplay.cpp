@@ -0,0 +1,81 @@
+// SELF-PLAY BATCH RUNNER //
+// Plays N seeded headless games across every core and prints throughput and
+// the score distribution.
+//
+// Build (from H1/tools): g++ -std=c++17 -O2 -pthread -I.. selfplay.cpp -o selfplay
+// Usage: selfplay [--games N] [--threads T] [--seed S] [--max-pieces P]
+//                 [--player random|ai] [--beam B] [--budget-us U] [--depth D] [--tt-mb M]
+//                 [--randomizer uniform|bag]
+
+#include "cstdio"
+#include "cstdlib"
+#include "cstring"
+#include "memory"
+#include "ai.h"
+#include "batch_runner.h"
+#include "tool_args.h"
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+    int games = 10000;
+    int threads = 0; // 0 = one per hardware thread
+    uint64_t seed = 1;
+    int maxPieces = 100000;
+    bool useAi = false;
+    int beam = 8;
+    long long budgetUs = 2000;
+    int depth = 1;
+    int tableMb = 0; // 0 = no transposition table
+    RandomizerKind randomizer = RANDOMIZER_UNIFORM;
+
+    ToolArgs args(argc, argv, 1);
+    const char* v;
+    while (args.next())
+    {
+        if (args.option("--games", v)) games = atoi(v);
+        else if (args.option("--threads", v)) threads = atoi(v);
+        else if (args.option("--seed", v)) seed = strtoull(v, nullptr, 10);
+        else if (args.option("--max-pieces", v)) maxPieces = atoi(v);
+        else if (args.option("--player", v)) useAi = strcmp(v, "ai") == 0;
+        else if (args.option("--beam", v)) beam = atoi(v);
+        else if (args.option("--budget-us", v)) budgetUs = atoll(v);
+        else if (args.option("--depth", v)) depth = atoi(v);
+        else if (args.option("--tt-mb", v)) tableMb = atoi(v);
+        else if (args.option("--randomizer", v)) randomizer = strcmp(v, "bag") == 0 ? RANDOMIZER_BAG : RANDOMIZER_UNIFORM;
+        else args.unknown();
+    }
+    if (!args.ok())
+    {
+        return 1;
+    }
+
+    WorkStealingPool pool(threads);
+    // One table shared by every game: values depend only on the board, so games can reuse each other's work
+    unique_ptr<TranspositionTable> table(tableMb > 0 ? new TranspositionTable(tableMb) : nullptr);
+
+    BatchReport report;
+    if (useAi)
+    {
+        // Games already fill every core, so each AI searches on its own game's thread
+        report = run_batch(pool, games, seed, maxPieces, [&](uint32_t) { return AiPlayer(nullptr, beam, budgetUs, depth, table.get()); },
+                           randomizer);
+    }
+    else
+    {
+        report = run_batch(pool, games, seed, maxPieces, [](uint32_t s) { return RandomPlayer(s); }, randomizer);
+    }
+
+    printf("player       %s\n", useAi ? "ai" : "random");
+    printf("randomizer   %s\n", randomizer == RANDOMIZER_BAG ? "bag" : "uniform");
+    printf("threads      %d\n", pool.size());
+    printf("games        %d in %.3f s\n", report.games, report.seconds);
+    printf("games/sec    %.2f\n", report.gamesPerSecond());
+    printf("pieces/sec   %.0f (%lld pieces, %lld lines)\n", report.piecesPerSecond(), report.pieces, report.lines);
+    printf("score mean   %.1f\n", report.meanScore());
+    printf("score p0/p25/p50/p75/p90/p99/p100  %d / %d / %d / %d / %d / %d / %d\n",
+           report.percentile(0), report.percentile(25), report.percentile(50), report.percentile(75),
+           report.percentile(90), report.percentile(99), report.percentile(100));
+    return 0;
+}
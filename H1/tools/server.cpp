@@ -0,0 +1,964 @@
+// GAME SERVER //
+// Hosts many GameSessions in one process so games are simulated on the
+// server. Clients connect over a Unix-domain socket, send input bytes and get
+// back delta frames (see session_protocol.h). The main thread only accepts
+// connections and deals them out to shards. A shard is one thread with its
+// own epoll loop, its own 60 Hz timerfd and a fixed table of sessions, so a
+// session is only ever touched by the thread that owns it and nothing is
+// locked while ticking. On each tick a shard applies the inputs that arrived,
+// advances every session and writes each changed session's frame; the tick
+// latency is the time from when the tick was due to when its last frame was
+// written. A shard that falls more than SERVER_MAX_CATCHUP ticks behind
+// skips the rest and counts them as late rather than letting latency grow.
+//
+// `clients` connects stand-in players that press random keys and rebuild each
+// game from the frames, checking it against the hashes the server sends.
+// `bench` runs the server and the clients in one process and reports ticks,
+// latency, bandwidth and how many sessions one core can host.
+//
+// Linux only (epoll, timerfd, eventfd).
+// Build (from H1/tools): g++ -std=c++17 -O2 -pthread -I.. server.cpp -o server
+// Usage: server serve   [--socket PATH] [--threads T] [--sessions N] [--seconds S]   (runs until Ctrl+C without --seconds)
+//        server clients [--socket PATH] [--threads T] [--sessions N] [--seconds S] [--seed S]
+//        server bench   [--socket PATH] [--threads T] [--client-threads C] [--sessions N] [--seconds S] [--seed S]
+
+#include "algorithm"
+#include "atomic"
+#include "cerrno"
+#include "chrono"
+#include "csignal"
+#include "cstdio"
+#include "cstdlib"
+#include "cstring"
+#include "memory"
+#include "mutex"
+#include "string"
+#include "thread"
+#include "vector"
+#include "batch_runner.h"
+#include "input.h"
+#include "session_protocol.h"
+#include "tool_args.h"
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace std;
+
+const long long TICK_NS = 1000000000LL / 60; // One simulation tick
+const int SERVER_MAX_INPUTS = 16; // Input bytes a session keeps between ticks; more are dropped
+const int SERVER_OUT_BYTES = 2048; // Unsent frames a session can hold; a client further behind is disconnected
+const int SERVER_MAX_CATCHUP = 4; // Ticks a late shard runs at once before skipping the rest
+const int SERVER_EVENTS = 256; // epoll events taken per wait
+const uint64_t TAG_TIMER = ~0ull; // epoll tags that are not session slots
+const uint64_t TAG_WAKE = ~1ull;
+
+volatile sig_atomic_t interrupted = 0; // Set by Ctrl+C, so `serve` still stops cleanly and reports
+
+// Function to handle SIGINT and SIGTERM
+void on_interrupt(int)
+{
+    interrupted = 1;
+}
+
+// Function to get the CPU time the calling thread has used, in seconds
+double thread_cpu_seconds()
+{
+    timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Function to start a periodic timerfd that fires once per tick; returns -1 on failure
+int open_tick_timer()
+{
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    itimerspec spec = {};
+    spec.it_interval.tv_nsec = TICK_NS;
+    spec.it_value.tv_nsec = TICK_NS;
+    timerfd_settime(fd, 0, &spec, nullptr);
+    return fd;
+}
+
+// Function to fill in a Unix socket address; returns false if the path is too long
+bool socket_address(const string& path, sockaddr_un& addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+    {
+        return false;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+// Function to let the process open as many sockets as the hard limit allows (two per session in bench mode)
+void raise_fd_limit()
+{
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+// Struct for one hosted game and its connection
+struct ServerSession
+{
+    GameSession game;
+    DeltaEncoder encoder;
+    int fd; // -1 if the slot is free
+    int livePos; // Index in the shard's live list
+    uint32_t seed;
+    bool softDrop;
+    bool waitingToWrite; // EPOLLOUT is registered because the socket was full
+    int inputCount;
+    uint8_t inputs[SERVER_MAX_INPUTS];
+    int outStart, outEnd; // Unsent bytes of `out`
+    uint8_t out[SERVER_OUT_BYTES];
+};
+
+// Struct for one shard: a thread, its epoll loop and the sessions it owns
+struct alignas(64) Shard
+{
+    int index;
+    int epollFd;
+    int timerFd;
+    int wakeFd; // Written by the acceptor when it hands over connections
+    vector<ServerSession> sessions; // Fixed table; a slot's index is its epoll tag
+    vector<int> freeSlots;
+    vector<int> live; // Slots with a connection, in no particular order
+    mutex handoffLock;
+    vector<int> handoff; // Accepted sockets waiting to be adopted
+    atomic<bool>* stopping;
+    thread worker;
+
+    // Results, read once the thread has stopped
+    LatencyHistogram tickLatency;
+    double maxTickMs;
+    long long ticks; // Shard ticks run
+    long long lateTicks; // Shard ticks skipped after falling behind
+    long long sessionTicks;
+    long long frames;
+    long long bytes;
+    long long inputs;
+    long long droppedInputs;
+    long long slowClients; // Disconnected because their frames piled up
+    long long rejected; // Connections that arrived when the table was full
+    long long peakSessions;
+    long long gamesStarted;
+    double cpuSeconds;
+
+    Shard() : index(0), epollFd(-1), timerFd(-1), wakeFd(-1), stopping(nullptr), maxTickMs(0), ticks(0), lateTicks(0), sessionTicks(0),
+              frames(0), bytes(0), inputs(0), droppedInputs(0), slowClients(0), rejected(0), peakSessions(0),
+              gamesStarted(0), cpuSeconds(0)
+    {
+    }
+
+    // Function to set up the table and the epoll loop; returns false if a descriptor could not be made
+    bool open(int shardIndex, int capacity, atomic<bool>* stop)
+    {
+        index = shardIndex;
+        stopping = stop;
+        sessions.resize(capacity);
+        for (int i = capacity - 1; i >= 0; i--)
+        {
+            sessions[i].fd = -1;
+            freeSlots.push_back(i);
+        }
+        live.reserve(capacity);
+        handoff.reserve(capacity);
+
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        timerFd = open_tick_timer();
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd < 0 || timerFd < 0 || wakeFd < 0)
+        {
+            return false;
+        }
+        epoll_event e = {};
+        e.events = EPOLLIN;
+        e.data.u64 = TAG_TIMER;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &e);
+        e.data.u64 = TAG_WAKE;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &e);
+        worker = thread([this] { run(); });
+        return true;
+    }
+
+    // Function for the acceptor to give this shard a connected socket
+    void give(int fd)
+    {
+        {
+            lock_guard<mutex> guard(handoffLock);
+            handoff.push_back(fd);
+        }
+        uint64_t one = 1;
+        ssize_t ignored = write(wakeFd, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    // Function to wait for the thread to stop (after *stopping is set) and close everything
+    void join()
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+        for (int slot : live)
+        {
+            ::close(sessions[slot].fd);
+        }
+        live.clear();
+        for (int fd : handoff)
+        {
+            ::close(fd);
+        }
+        handoff.clear();
+        ::close(epollFd);
+        ::close(timerFd);
+        ::close(wakeFd);
+    }
+
+private:
+    chrono::steady_clock::time_point firstDue; // When the first tick was due
+    long long dueTicks; // Ticks that have come due so far
+
+    void run()
+    {
+        epoll_event events[SERVER_EVENTS];
+        firstDue = chrono::steady_clock::now() + chrono::nanoseconds(TICK_NS);
+        dueTicks = 0;
+        while (!stopping->load(memory_order_relaxed))
+        {
+            int n = epoll_wait(epollFd, events, SERVER_EVENTS, 100);
+            for (int i = 0; i < n; i++)
+            {
+                uint64_t tag = events[i].data.u64;
+                if (tag == TAG_TIMER)
+                {
+                    uint64_t expirations = 0;
+                    if (read(timerFd, &expirations, sizeof(expirations)) == sizeof(expirations))
+                    {
+                        tickAll(static_cast<long long>(expirations));
+                    }
+                }
+                else if (tag == TAG_WAKE)
+                {
+                    adopt();
+                }
+                else
+                {
+                    int slot = static_cast<int>(tag);
+                    if (sessions[slot].fd >= 0 && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+                    {
+                        readInputs(slot);
+                    }
+                    if (sessions[slot].fd >= 0 && (events[i].events & EPOLLOUT))
+                    {
+                        flush(slot);
+                    }
+                }
+            }
+        }
+        cpuSeconds = thread_cpu_seconds();
+    }
+
+    // Function to take over the sockets the acceptor handed over
+    void adopt()
+    {
+        uint64_t count;
+        ssize_t ignored = read(wakeFd, &count, sizeof(count));
+        (void)ignored;
+        lock_guard<mutex> guard(handoffLock);
+        for (int fd : handoff)
+        {
+            if (freeSlots.empty())
+            {
+                ::close(fd);
+                rejected++;
+                continue;
+            }
+            int slot = freeSlots.back();
+            freeSlots.pop_back();
+            ServerSession& s = sessions[slot];
+            s.fd = fd;
+            s.livePos = static_cast<int>(live.size());
+            live.push_back(slot);
+            newGame(s);
+            s.softDrop = false;
+            s.waitingToWrite = false;
+            s.inputCount = 0;
+            s.outStart = 0;
+            s.outEnd = 0;
+
+            epoll_event e = {};
+            e.events = EPOLLIN;
+            e.data.u64 = static_cast<uint64_t>(slot);
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &e);
+        }
+        handoff.clear();
+        peakSessions = max(peakSessions, static_cast<long long>(live.size()));
+    }
+
+    // Function to close a session's connection and free its slot
+    void drop(int slot)
+    {
+        ServerSession& s = sessions[slot];
+        ::close(s.fd); // Also removes it from the epoll set
+        s.fd = -1;
+        int last = live.back();
+        live[s.livePos] = last;
+        sessions[last].livePos = s.livePos;
+        live.pop_back();
+        freeSlots.push_back(slot);
+    }
+
+    // Function to read the input bytes waiting on a session's socket; they are applied at the next tick
+    void readInputs(int slot)
+    {
+        ServerSession& s = sessions[slot];
+        uint8_t buffer[256];
+        for (;;)
+        {
+            ssize_t got = recv(s.fd, buffer, sizeof(buffer), 0);
+            if (got > 0)
+            {
+                for (ssize_t i = 0; i < got; i++)
+                {
+                    if (buffer[i] > NET_RESTART)
+                    {
+                        drop(slot); // Not a client of this protocol
+                        return;
+                    }
+                    if (s.inputCount < SERVER_MAX_INPUTS)
+                    {
+                        s.inputs[s.inputCount++] = buffer[i];
+                    }
+                    else
+                    {
+                        droppedInputs++;
+                    }
+                }
+                inputs += got;
+                continue;
+            }
+            if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                return;
+            }
+            if (got < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            drop(slot); // Closed by the client, or failed
+            return;
+        }
+    }
+
+    // Function to write as much of a session's unsent frames as the socket takes, waiting for EPOLLOUT if it is full
+    void flush(int slot)
+    {
+        ServerSession& s = sessions[slot];
+        while (s.outStart < s.outEnd)
+        {
+            ssize_t sent = send(s.fd, s.out + s.outStart, s.outEnd - s.outStart, MSG_NOSIGNAL);
+            if (sent > 0)
+            {
+                s.outStart += static_cast<int>(sent);
+                continue;
+            }
+            if (sent < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                break;
+            }
+            drop(slot);
+            return;
+        }
+        if (s.outStart == s.outEnd)
+        {
+            s.outStart = 0;
+            s.outEnd = 0;
+        }
+
+        bool blocked = s.outStart < s.outEnd;
+        if (blocked != s.waitingToWrite)
+        {
+            epoll_event e = {};
+            e.events = EPOLLIN;
+            if (blocked)
+            {
+                e.events |= EPOLLOUT;
+            }
+            e.data.u64 = static_cast<uint64_t>(slot);
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, s.fd, &e);
+            s.waitingToWrite = blocked;
+        }
+    }
+
+    // Function to start a session's next game; every game a shard starts gets its own seed
+    void newGame(ServerSession& s)
+    {
+        s.seed = game_seed(static_cast<uint64_t>(index) + 1, static_cast<int>(gamesStarted++));
+        s.game.reset(1, s.seed);
+        s.encoder.reset();
+    }
+
+    // Function to apply a session's queued inputs at the start of a tick
+    void applyInputs(ServerSession& s)
+    {
+        for (int i = 0; i < s.inputCount; i++)
+        {
+            uint8_t input = s.inputs[i];
+            if (input == NET_SOFT_DROP_ON || input == NET_SOFT_DROP_OFF)
+            {
+                s.softDrop = input == NET_SOFT_DROP_ON;
+            }
+            else if (input == NET_RESTART)
+            {
+                newGame(s);
+            }
+            else
+            {
+                s.game.apply(static_cast<GameAction>(input));
+            }
+        }
+        s.inputCount = 0;
+    }
+
+    // Function to run the ticks that have come due for every session and send the frames
+    void tickAll(long long expirations)
+    {
+        dueTicks += expirations;
+        long long run = min<long long>(expirations, SERVER_MAX_CATCHUP);
+        lateTicks += expirations - run;
+        ticks += run;
+
+        for (size_t i = 0; i < live.size();)
+        {
+            int slot = live[i];
+            ServerSession& s = sessions[slot];
+            for (long long t = 0; t < run; t++)
+            {
+                if (t == 0)
+                {
+                    applyInputs(s);
+                }
+                s.game.tick(s.softDrop);
+                if (SERVER_OUT_BYTES - s.outEnd < NET_FRAME_MAX)
+                {
+                    break;
+                }
+                int n = s.encoder.encode(s.game, s.out + s.outEnd);
+                s.outEnd += n;
+                frames += n > 0;
+                bytes += n;
+            }
+            sessionTicks += run;
+
+            if (SERVER_OUT_BYTES - s.outEnd < NET_FRAME_MAX)
+            {
+                // The client stopped reading; drop it rather than hold frames for it
+                slowClients++;
+                drop(slot);
+                continue; // drop() moved another session into position i
+            }
+            if (!s.waitingToWrite)
+            {
+                flush(slot);
+                if (sessions[slot].fd < 0)
+                {
+                    continue;
+                }
+            }
+            i++;
+        }
+
+        // Latency of the newest due tick, from when it was due to now
+        chrono::steady_clock::time_point due = firstDue + chrono::nanoseconds(TICK_NS * (dueTicks - 1));
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - due).count();
+        tickLatency.add(seconds);
+        maxTickMs = max(maxTickMs, seconds * 1000);
+    }
+};
+
+// Struct for the listening socket and the thread that deals connections out to shards
+struct Acceptor
+{
+    int listenFd;
+    string path;
+    thread worker;
+
+    Acceptor() : listenFd(-1) {}
+
+    // Function to bind and listen on a Unix socket path (replacing a stale one); returns false on failure
+    bool open(const string& socketPath)
+    {
+        path = socketPath;
+        sockaddr_un addr;
+        if (!socket_address(path, addr))
+        {
+            return false;
+        }
+        unlink(path.c_str());
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        return listenFd >= 0 && bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 && listen(listenFd, SOMAXCONN) == 0;
+    }
+
+    // Function to start accepting, giving each new connection to the next shard in turn
+    void start(vector<unique_ptr<Shard>>& shards, atomic<bool>& stopping)
+    {
+        worker = thread([this, &shards, &stopping]
+        {
+            int epollFd = epoll_create1(EPOLL_CLOEXEC);
+            epoll_event e = {};
+            e.events = EPOLLIN;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &e);
+            size_t next = 0;
+            while (!stopping.load(memory_order_relaxed))
+            {
+                if (epoll_wait(epollFd, &e, 1, 100) <= 0)
+                {
+                    continue;
+                }
+                int fd;
+                while ((fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+                {
+                    shards[next]->give(fd);
+                    next = (next + 1) % shards.size();
+                }
+            }
+            ::close(epollFd);
+        });
+    }
+
+    void close()
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+        if (listenFd >= 0)
+        {
+            ::close(listenFd);
+            unlink(path.c_str());
+            listenFd = -1;
+        }
+    }
+};
+
+// Struct for one stand-in player's connection
+struct ClientConnection
+{
+    int fd;
+    SessionMirror mirror;
+    RandomPlayer rng;
+    bool softDrop;
+    bool restartSent;
+    int used; // Bytes of a partial frame waiting in `in`
+    uint8_t in[1024];
+
+    explicit ClientConnection(uint32_t seed) : fd(-1), rng(seed), softDrop(false), restartSent(false), used(0) {}
+};
+
+// Struct for one thread of stand-in players
+struct alignas(64) ClientWorker
+{
+    vector<unique_ptr<ClientConnection>> connections;
+    thread worker;
+    long long connectFailures;
+    long long inputsSent;
+    long long inputsDropped; // The socket was full
+    long long frames;
+    long long bytes;
+    long long hashChecks;
+    long long hashMismatches;
+    long long malformed;
+    long long disconnected;
+
+    ClientWorker() : connectFailures(0), inputsSent(0), inputsDropped(0), frames(0), bytes(0), hashChecks(0), hashMismatches(0), malformed(0), disconnected(0) {}
+
+    // Function to connect `count` players and play until told to stop
+    void start(const string& path, int count, uint64_t seed, int firstIndex, atomic<bool>& stopping)
+    {
+        worker = thread([this, path, count, seed, firstIndex, &stopping] { run(path, count, seed, firstIndex, stopping); });
+    }
+
+    void join()
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+
+private:
+    void run(const string& path, int count, uint64_t seed, int firstIndex, atomic<bool>& stopping)
+    {
+        sockaddr_un addr;
+        socket_address(path, addr);
+        int epollFd = epoll_create1(EPOLL_CLOEXEC);
+        for (int i = 0; i < count && !stopping.load(); i++)
+        {
+            int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            // The server may still be starting, so retry for a while
+            bool connected = false;
+            for (int attempt = 0; attempt < 200 && !connected; attempt++)
+            {
+                connected = connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+                if (!connected)
+                {
+                    this_thread::sleep_for(chrono::milliseconds(10));
+                }
+            }
+            if (!connected)
+            {
+                ::close(fd);
+                connectFailures++;
+                continue;
+            }
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            unique_ptr<ClientConnection> c(new ClientConnection(game_seed(seed, firstIndex + i)));
+            c->fd = fd;
+            epoll_event e = {};
+            e.events = EPOLLIN;
+            e.data.u64 = connections.size();
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &e);
+            connections.push_back(move(c));
+        }
+
+        int timerFd = open_tick_timer();
+        epoll_event timer = {};
+        timer.events = EPOLLIN;
+        timer.data.u64 = TAG_TIMER;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &timer);
+
+        epoll_event events[SERVER_EVENTS];
+        while (!stopping.load(memory_order_relaxed))
+        {
+            int n = epoll_wait(epollFd, events, SERVER_EVENTS, 100);
+            for (int i = 0; i < n; i++)
+            {
+                if (events[i].data.u64 == TAG_TIMER)
+                {
+                    uint64_t expirations;
+                    if (read(timerFd, &expirations, sizeof(expirations)) == sizeof(expirations))
+                    {
+                        press();
+                    }
+                }
+                else
+                {
+                    receive(*connections[events[i].data.u64]);
+                }
+            }
+        }
+
+        for (unique_ptr<ClientConnection>& c : connections)
+        {
+            hashChecks += c->mirror.hashChecks;
+            hashMismatches += c->mirror.hashMismatches;
+            frames += c->mirror.frames;
+            if (c->fd >= 0)
+            {
+                ::close(c->fd);
+            }
+        }
+        ::close(timerFd);
+        ::close(epollFd);
+    }
+
+    // Function to send this tick's key presses for every player: a few moves, rotations and drops, and a restart after game over
+    void press()
+    {
+        for (unique_ptr<ClientConnection>& c : connections)
+        {
+            if (c->fd < 0)
+            {
+                continue;
+            }
+            uint8_t keys[3];
+            int count = 0;
+            if (c->mirror.gameOver)
+            {
+                if (!c->restartSent)
+                {
+                    keys[count++] = NET_RESTART;
+                    c->restartSent = true;
+                }
+            }
+            else
+            {
+                c->restartSent = false;
+                int roll = c->rng.next(120);
+                if (roll < 12)
+                {
+                    keys[count++] = static_cast<uint8_t>(roll % 3); // Left, right or rotate
+                }
+                else if (roll == 12)
+                {
+                    keys[count++] = ACTION_HARD_DROP;
+                }
+                else if (roll == 13)
+                {
+                    c->softDrop = !c->softDrop;
+                    keys[count++] = c->softDrop ? NET_SOFT_DROP_ON : NET_SOFT_DROP_OFF;
+                }
+            }
+            if (count == 0)
+            {
+                continue;
+            }
+            ssize_t sent = send(c->fd, keys, count, MSG_NOSIGNAL);
+            if (sent == count)
+            {
+                inputsSent += count;
+            }
+            else
+            {
+                inputsDropped += count;
+            }
+        }
+    }
+
+    // Function to read and apply the frames waiting for one player
+    void receive(ClientConnection& c)
+    {
+        for (;;)
+        {
+            ssize_t got = recv(c.fd, c.in + c.used, sizeof(c.in) - c.used, 0);
+            if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                return;
+            }
+            if (got < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (got <= 0)
+            {
+                disconnected++;
+                ::close(c.fd);
+                c.fd = -1;
+                return;
+            }
+            bytes += got;
+            c.used += static_cast<int>(got);
+            int applied = c.mirror.apply(c.in, c.used);
+            if (applied < 0)
+            {
+                malformed++;
+                disconnected++;
+                ::close(c.fd);
+                c.fd = -1;
+                return;
+            }
+            memmove(c.in, c.in + applied, c.used - applied);
+            c.used -= applied;
+        }
+    }
+};
+
+// Function to print what the shards did over `seconds` of wall time
+void report_server(vector<unique_ptr<Shard>>& shards, double seconds)
+{
+    LatencyHistogram latency;
+    double maxMs = 0, cpu = 0;
+    long long ticks = 0, late = 0, sessionTicks = 0, frames = 0, bytes = 0, inputs = 0, droppedInputs = 0, slow = 0, rejected = 0, peak = 0;
+    for (unique_ptr<Shard>& s : shards)
+    {
+        for (int i = 0; i < LATENCY_BUCKETS; i++)
+        {
+            latency.counts[i] += s->tickLatency.counts[i];
+        }
+        latency.total += s->tickLatency.total;
+        maxMs = max(maxMs, s->maxTickMs);
+        cpu += s->cpuSeconds;
+        ticks += s->ticks;
+        late += s->lateTicks;
+        sessionTicks += s->sessionTicks;
+        frames += s->frames;
+        bytes += s->bytes;
+        inputs += s->inputs;
+        droppedInputs += s->droppedInputs;
+        slow += s->slowClients;
+        rejected += s->rejected;
+        peak += s->peakSessions;
+    }
+    double sessionSeconds = sessionTicks * (TICK_NS * 1e-9);
+    printf("sessions     %lld at peak on %d shard threads (%lld rejected, %lld dropped as too slow)\n", peak, static_cast<int>(shards.size()), rejected, slow);
+    printf("ticks        %lld session ticks in %.2f s (%.0f per second); %lld late shard ticks skipped of %lld\n", sessionTicks, seconds,
+           sessionTicks / seconds, late, ticks + late);
+    printf("tick latency p50 %.1f ms, p99 %.1f ms, max %.2f ms (due to last frame written)\n", latency.percentileMs(50), latency.percentileMs(99), maxMs);
+    printf("traffic      %lld frames, %.1f bytes per session-second out; %lld inputs in (%lld dropped)\n", frames,
+           sessionSeconds > 0 ? bytes / sessionSeconds : 0, inputs, droppedInputs);
+    printf("cpu          %.2f s on shard threads, %.0f us per session-second; one core could host about %.0f sessions\n", cpu,
+           sessionSeconds > 0 ? cpu / sessionSeconds * 1e6 : 0, cpu > 0 ? sessionSeconds / cpu : 0);
+}
+
+// Function to print what the stand-in players saw; returns false if any frame was malformed or any hash did not match
+bool report_clients(vector<unique_ptr<ClientWorker>>& clients)
+{
+    long long failures = 0, sent = 0, dropped = 0, frames = 0, bytes = 0, checks = 0, mismatches = 0, malformed = 0, disconnected = 0;
+    for (unique_ptr<ClientWorker>& c : clients)
+    {
+        failures += c->connectFailures;
+        sent += c->inputsSent;
+        dropped += c->inputsDropped;
+        frames += c->frames;
+        bytes += c->bytes;
+        checks += c->hashChecks;
+        mismatches += c->hashMismatches;
+        malformed += c->malformed;
+        disconnected += c->disconnected;
+    }
+    printf("clients      %lld inputs sent (%lld dropped), %lld frames, %lld bytes; %lld could not connect, %lld disconnected\n", sent, dropped, frames,
+           bytes, failures, disconnected);
+    printf("checks       %lld board hashes, %lld mismatched, %lld malformed frames\n", checks, mismatches, malformed);
+    return mismatches == 0 && malformed == 0;
+}
+
+// Function to start the shards and the acceptor; returns false if the socket or a shard could not be set up
+bool start_server(const string& path, int threads, int sessions, vector<unique_ptr<Shard>>& shards, Acceptor& acceptor, atomic<bool>& stopping)
+{
+    int capacity = (sessions + threads - 1) / threads;
+    for (int i = 0; i < threads; i++)
+    {
+        shards.emplace_back(new Shard());
+        if (!shards.back()->open(i, capacity, &stopping))
+        {
+            fprintf(stderr, "could not set up shard %d\n", i);
+            return false;
+        }
+    }
+    if (!acceptor.open(path))
+    {
+        fprintf(stderr, "could not listen on %s: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    acceptor.start(shards, stopping);
+    return true;
+}
+
+// Function to connect `sessions` players spread over `threads` threads
+void start_clients(const string& path, int threads, int sessions, uint64_t seed, vector<unique_ptr<ClientWorker>>& clients, atomic<bool>& stopping)
+{
+    int first = 0;
+    for (int i = 0; i < threads; i++)
+    {
+        int count = sessions / threads + (i < sessions % threads ? 1 : 0);
+        clients.emplace_back(new ClientWorker());
+        clients.back()->start(path, count, seed, first, stopping);
+        first += count;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || (strcmp(argv[1], "serve") != 0 && strcmp(argv[1], "clients") != 0 && strcmp(argv[1], "bench") != 0))
+    {
+        fprintf(stderr, "usage: server serve|clients|bench [options]\n");
+        return 1;
+    }
+    string mode = argv[1];
+    string path = "tetris_server.sock";
+    int threads = max(1u, thread::hardware_concurrency());
+    int clientThreads = 1;
+    int sessions = 1000;
+    double seconds = mode == "serve" ? 0 : 10; // 0 = until killed
+    uint64_t seed = 1;
+
+    ToolArgs args(argc, argv, 2);
+    const char* v;
+    while (args.next())
+    {
+        if (args.option("--socket", v)) path = v;
+        else if (args.option("--threads", v)) threads = max(1, atoi(v));
+        else if (args.option("--client-threads", v)) clientThreads = max(1, atoi(v));
+        else if (args.option("--sessions", v)) sessions = max(1, atoi(v));
+        else if (args.option("--seconds", v)) seconds = atof(v);
+        else if (args.option("--seed", v)) seed = strtoull(v, nullptr, 10);
+        else args.unknown();
+    }
+    if (!args.ok())
+    {
+        return 1;
+    }
+    raise_fd_limit();
+    signal(SIGINT, on_interrupt);
+    signal(SIGTERM, on_interrupt);
+
+    atomic<bool> serverStopping(false);
+    atomic<bool> clientsStopping(false);
+    vector<unique_ptr<Shard>> shards;
+    vector<unique_ptr<ClientWorker>> clients;
+    Acceptor acceptor;
+
+    bool serving = mode != "clients";
+    if (serving && !start_server(path, threads, sessions, shards, acceptor, serverStopping))
+    {
+        serverStopping = true;
+        acceptor.close();
+        for (unique_ptr<Shard>& s : shards)
+        {
+            s->join();
+        }
+        return 1;
+    }
+    if (mode != "serve")
+    {
+        start_clients(path, mode == "bench" ? clientThreads : threads, sessions, seed, clients, clientsStopping);
+    }
+    if (serving)
+    {
+        printf("serving      %d sessions on %s with %d shard threads\n", sessions, path.c_str(), threads);
+        fflush(stdout);
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    while (!interrupted && (seconds <= 0 || chrono::duration<double>(chrono::steady_clock::now() - start).count() < seconds))
+    {
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+
+    // Stop the players first so the server does not count their disconnects as failures
+    clientsStopping = true;
+    for (unique_ptr<ClientWorker>& c : clients)
+    {
+        c->join();
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    serverStopping = true;
+    acceptor.close();
+    for (unique_ptr<Shard>& s : shards)
+    {
+        s->join();
+    }
+
+    if (serving)
+    {
+        report_server(shards, elapsed);
+    }
+    if (!clients.empty() && !report_clients(clients))
+    {
+        return 2;
+    }
+    return 0;
+}
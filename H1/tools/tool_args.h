@@ -0,0 +1,64 @@
+// TOOL ARGUMENTS //
+// Reads the `--option value` pairs the tools take. Each argument is matched
+// against the tool's option names first, so a mistyped or unsupported option
+// is reported as unknown wherever it is, and only an option the tool knows
+// asks for a value.
+
+#ifndef TETRIS_TOOL_ARGS_H
+#define TETRIS_TOOL_ARGS_H
+
+#include "cstdio"
+#include "cstring"
+
+// Struct for walking a tool's options
+struct ToolArgs
+{
+    // `first` is the index of the first option (after any command word)
+    ToolArgs(int argc, char** argv, int first) : argc(argc), argv(argv), at(first - 2), failed(false) {}
+
+    // Function to move to the next option; returns false when there are none left or one was wrong
+    bool next()
+    {
+        at += 2;
+        return !failed && at < argc;
+    }
+
+    // Function to tell whether the current option is `name`; if it is, `value` is set to its value (a missing one is reported)
+    bool option(const char* name, const char*& value)
+    {
+        if (strcmp(argv[at], name) != 0)
+        {
+            return false;
+        }
+        if (at + 1 == argc)
+        {
+            fprintf(stderr, "missing value for option %s\n", name);
+            failed = true;
+            value = "";
+            return true;
+        }
+        value = argv[at + 1];
+        return true;
+    }
+
+    // Function to report the current option as one the tool does not have
+    void unknown()
+    {
+        fprintf(stderr, "unknown option %s\n", argv[at]);
+        failed = true;
+    }
+
+    // Function to tell whether every option was read
+    bool ok() const
+    {
+        return !failed;
+    }
+
+private:
+    int argc;
+    char** argv;
+    int at; // Index of the current option
+    bool failed;
+};
+
+#endif
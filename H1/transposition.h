@@ -0,0 +1,85 @@
+// TRANSPOSITION TABLE //
+// A fixed-size cache of search values keyed by Zobrist hash, shared by all
+// search threads without locks. Each slot stores (key ^ value, value) in two
+// atomic words. A reader that sees half of one write and half of another gets
+// a check word that does not match and treats the slot as a miss, so torn
+// entries are never returned. New entries always replace old ones, so memory
+// use never grows.
+
+#ifndef TETRIS_TRANSPOSITION_H
+#define TETRIS_TRANSPOSITION_H
+
+#include "atomic"
+#include "cstdint"
+#include "cstring"
+#include "memory"
+
+// Struct for one slot of the table
+struct TranspositionEntry
+{
+    std::atomic<uint64_t> check; // key ^ data
+    std::atomic<uint64_t> data; // The stored value's bits
+};
+
+// Struct for the table itself
+struct TranspositionTable
+{
+    // Creates a table using at most the given number of megabytes (rounded down to a power of two entries)
+    explicit TranspositionTable(size_t megabytes)
+    {
+        size_t count = 1;
+        while (count * 2 * sizeof(TranspositionEntry) <= megabytes * 1024 * 1024)
+        {
+            count *= 2;
+        }
+        mask = count - 1;
+        entries.reset(new TranspositionEntry[count]);
+        clear();
+    }
+
+    // Function to forget every entry
+    void clear()
+    {
+        for (size_t i = 0; i <= mask; i++)
+        {
+            entries[i].check.store(0, std::memory_order_relaxed);
+            entries[i].data.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Number of slots in the table
+    size_t size() const
+    {
+        return mask + 1;
+    }
+
+    // Function to look up a value; returns false if the key is not in the table
+    bool probe(uint64_t key, double& value) const
+    {
+        const TranspositionEntry& e = entries[key & mask];
+        uint64_t data = e.data.load(std::memory_order_relaxed);
+        uint64_t check = e.check.load(std::memory_order_relaxed);
+        if ((check ^ data) != key || key == 0)
+        {
+            return false;
+        }
+        memcpy(&value, &data, sizeof(value));
+        return true;
+    }
+
+    // Function to store a value, replacing whatever was in its slot
+    void store(uint64_t key, double value)
+    {
+        uint64_t data;
+        memcpy(&data, &value, sizeof(data));
+        TranspositionEntry& e = entries[key & mask];
+        e.check.store(key ^ data, std::memory_order_relaxed);
+        e.data.store(data, std::memory_order_relaxed);
+    }
+
+private:
+    std::unique_ptr<TranspositionEntry[]> entries;
+    size_t mask;
+};
+
+#endif
@@ -0,0 +1,57 @@
+// ZOBRIST KEYS //
+// Random 64-bit keys for hashing positions. A board's hash is the XOR of the
+// keys of its filled cells, so locking a piece or clearing a row only updates
+// the cells that changed. The keys are generated at compile time from a fixed
+// seed, so hashes are the same on every run and every thread.
+
+#ifndef TETRIS_ZOBRIST_H
+#define TETRIS_ZOBRIST_H
+
+#include "cstdint"
+
+// Function to scramble a 64-bit value (splitmix64 finalizer)
+constexpr uint64_t mix64(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Struct for the cell keys of a board with the given dimensions
+template <int W, int H>
+struct ZobristKeys
+{
+    uint64_t cells[H][W];
+};
+
+// Function to fill the cell keys from a fixed splitmix64 sequence
+template <int W, int H>
+constexpr ZobristKeys<W, H> make_zobrist_keys()
+{
+    ZobristKeys<W, H> keys = {};
+    uint64_t state = 0x7E7215C0FFEEull;
+    for (int y = 0; y < H; y++)
+    {
+        for (int x = 0; x < W; x++)
+        {
+            state += 0x9E3779B97F4A7C15ull;
+            keys.cells[y][x] = mix64(state);
+        }
+    }
+    return keys;
+}
+
+// Function to get the key of a falling piece, mixed on the fly rather than stored
+constexpr uint64_t zobrist_piece_key(int shape, int rotation, int x, int y)
+{
+    return mix64(0xA5A5F00Dull ^ (static_cast<uint64_t>(shape) << 48) ^ (static_cast<uint64_t>(rotation) << 40)
+                 ^ (static_cast<uint64_t>(x + 128) << 20) ^ static_cast<uint64_t>(y + 128));
+}
+
+// Function to get the key mixed into a search value's hash to tell search depths apart
+constexpr uint64_t zobrist_depth_key(int depth)
+{
+    return mix64(0xD3E9711Full + static_cast<uint64_t>(depth));
+}
+
+#endif